@@ -9,8 +9,6 @@
  * published by the Free Software Foundation.
  */
 
-#define DEBUG 1
-
 /* #undef DEBUG
  * use 'make DEBUG=1' to enable debugging
  */
@@ -25,6 +23,8 @@
 #include <linux/workqueue.h>
 #include <linux/regmap.h>
 #include <linux/gpio/consumer.h>
+#include <linux/ktime.h>
+#include <linux/pm_runtime.h>
 #include <sound/core.h>
 #include <sound/pcm.h>
 #include <sound/pcm_params.h>
@@ -34,12 +34,9 @@
 #include "ac108.h"
 #include "ac10x.h"
 
-/**
- * TODO: 
- * 1, add PM API:  ac108_suspend,ac108_resume 
- * 2,0x65-0x6a 
- * 3,0x76-0x79 high 4bit 
- */
+#define CREATE_TRACE_POINTS
+#include "ac108_trace.h"
+
 struct pll_div {
 	unsigned int freq_in;
 	unsigned int freq_out;
@@ -181,23 +178,43 @@ int ac10x_read(u8 reg, u8* rt_val, struct regmap* i2cm) {
 }
 
 int ac10x_write(u8 reg, u8 val, struct regmap* i2cm) {
+	u64 t0 = trace_ac108_reg_write_enabled() ? ktime_get_ns() : 0;
 	int r;
 
 	if ((r = regmap_write(i2cm, reg, val)) < 0) {
 		pr_err("ac10x_write error->[REG-0x%02x,val-0x%02x]\n", reg, val);
 	}
+	trace_ac108_reg_write(i2cm, reg, 0xFF, val, r, t0 ? ktime_get_ns() - t0 : 0);
 	return r;
 }
 
 int ac10x_update_bits(u8 reg, u8 mask, u8 val, struct regmap* i2cm) {
+	u64 t0 = trace_ac108_reg_update_enabled() ? ktime_get_ns() : 0;
 	int r;
 
 	if ((r = regmap_update_bits(i2cm, reg, mask, val)) < 0) {
 		pr_err("%s() error->[REG-0x%02x,val-0x%02x]\n", __func__, reg, val);
 	}
+	trace_ac108_reg_update(i2cm, reg, mask, val, r, t0 ? ktime_get_ns() - t0 : 0);
+	return r;
+}
+
+static int ac10x_bulk_write(u8 reg, const u8 *val, int count, struct regmap* i2cm) {
+	u64 t0 = trace_ac108_reg_bulk_write_enabled() ? ktime_get_ns() : 0;
+	int r;
+
+	if ((r = regmap_bulk_write(i2cm, reg, val, count)) < 0) {
+		pr_err("%s() error->[REG-0x%02x,count-%d]\n", __func__, reg, count);
+	}
+	trace_ac108_reg_bulk_write(i2cm, reg, count, r, t0 ? ktime_get_ns() - t0 : 0);
 	return r;
 }
 
+/* chips of a control, all of them or the one of a per chip component */
+static struct ac10x_priv *ac108_kcontrol_priv(struct snd_kcontrol *kcontrol) {
+	return snd_soc_codec_get_drvdata(snd_soc_kcontrol_codec(kcontrol));
+}
+
 /**
  * snd_ac108_get_volsw - single mixer get callback
  * @kcontrol: mixer control
@@ -211,6 +228,7 @@ int ac10x_update_bits(u8 reg, u8 mask, u8 val, struct regmap* i2cm) {
 static int snd_ac108_get_volsw(struct snd_kcontrol *kcontrol,
 	struct snd_ctl_elem_value *ucontrol
 ){
+	struct ac10x_priv *priv = ac108_kcontrol_priv(kcontrol);
 	struct soc_mixer_control *mc =
 		(struct soc_mixer_control *)kcontrol->private_value;
 	unsigned int mask = (1 << fls(mc->max)) - 1;
@@ -218,7 +236,7 @@ static int snd_ac108_get_volsw(struct snd_kcontrol *kcontrol,
 	int ret, chip = mc->autodisable;
 	u8 val;
 
-	if ((ret = ac10x_read(mc->reg, &val, ac10x->i2cmap[chip])) < 0)
+	if ((ret = ac10x_read(mc->reg, &val, priv->i2cmap[chip])) < 0)
 		return ret;
 
 	val = ((val >> mc->shift) & mask) - mc->min;
@@ -242,6 +260,7 @@ static int snd_ac108_get_volsw(struct snd_kcontrol *kcontrol,
 static int snd_ac108_put_volsw(struct snd_kcontrol *kcontrol,
 	struct snd_ctl_elem_value *ucontrol
 ){
+	struct ac10x_priv *priv = ac108_kcontrol_priv(kcontrol);
 	struct soc_mixer_control *mc =
 		(struct soc_mixer_control *)kcontrol->private_value;
 	unsigned int sign_bit = mc->sign_bit;
@@ -260,10 +279,278 @@ static int snd_ac108_put_volsw(struct snd_kcontrol *kcontrol,
 	mask = mask << mc->shift;
 	val = val << mc->shift;
 
-	ret = ac10x_update_bits(mc->reg, mask, val, ac10x->i2cmap[chip]);
+	ret = ac10x_update_bits(mc->reg, mask, val, priv->i2cmap[chip]);
 	return ret;
 }
 
+/*
+ * one pole HPF of the ADC digital path, 24-bit fixed point:
+ *   coef = exp(-2*pi*fc/fs), gain = (1 + coef) / 2
+ * reset values 0xFFAA45 / 0xFFD522 are about 10Hz @ 48KHz.
+ */
+static void ac108_hpf_calc(unsigned fc, unsigned fs, u32 *coef, u32 *gain) {
+	/* 2 * pi * 2^24 */
+	s64 x = div_u64((u64)fc * 105414358ULL, fs);
+	s64 term = 1 << 24, sum = term;
+	int n;
+
+	/* exp(-x), x <= 2*pi*1000/8000 */
+	for (n = 1; n <= 10; n++) {
+		term = div_s64(-term * x, n) >> 24;
+		sum += term;
+	}
+	*coef = clamp_t(s64, sum, 0, 0xFFFFFF);
+	*gain = ((1 << 24) + *coef) / 2;
+}
+
+static int ac108_set_hpf(struct ac10x_priv *ac10x, unsigned rate) {
+	u32 coef, gain;
+
+	ac10x->hpf_rate = rate;
+	if (!ac10x->hpf_cutoff) {
+		/*0x66: HPF of ADC1-4 off*/
+		return ac108_multi_write(HPF_EN, 0x00, ac10x);
+	}
+
+	ac108_hpf_calc(ac10x->hpf_cutoff, rate, &coef, &gain);
+	dev_dbg(&ac10x->i2c[_MASTER_INDEX]->dev, "HPF %uHz @ %uHz, coef 0x%06x gain 0x%06x\n",
+		ac10x->hpf_cutoff, rate, coef, gain);
+
+	/*0x67-0x6A: HPF coefficient, MSB first*/
+	ac108_multi_write(HPF_COEF_REGH1, (coef >> 24) & 0xFF, ac10x);
+	ac108_multi_write(HPF_COEF_REGH2, (coef >> 16) & 0xFF, ac10x);
+	ac108_multi_write(HPF_COEF_REGL1, (coef >> 8) & 0xFF, ac10x);
+	ac108_multi_write(HPF_COEF_REGL2, (coef >> 0) & 0xFF, ac10x);
+	/*0x6B-0x6E: HPF gain, MSB first*/
+	ac108_multi_write(HPF_GAIN_REGH1, (gain >> 24) & 0xFF, ac10x);
+	ac108_multi_write(HPF_GAIN_REGH2, (gain >> 16) & 0xFF, ac10x);
+	ac108_multi_write(HPF_GAIN_REGL1, (gain >> 8) & 0xFF, ac10x);
+	ac108_multi_write(HPF_GAIN_REGL2, (gain >> 0) & 0xFF, ac10x);
+	/*0x66: HPF of ADC1-4 on*/
+	return ac108_multi_write(HPF_EN, 0x0F, ac10x);
+}
+
+static int snd_ac108_info_hpf(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_info *uinfo
+){
+	uinfo->type = SNDRV_CTL_ELEM_TYPE_INTEGER;
+	uinfo->count = 1;
+	uinfo->value.integer.min = 0;
+	uinfo->value.integer.max = AC108_HPF_CUTOFF_MAX;
+	return 0;
+}
+
+static int snd_ac108_get_hpf(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_value *ucontrol
+){
+	struct ac10x_priv *priv = ac108_kcontrol_priv(kcontrol);
+
+	ucontrol->value.integer.value[0] = priv->hpf_cutoff;
+	return 0;
+}
+
+/* takes effect at once if the ADC rate is known, else at next hw_params() */
+static int snd_ac108_put_hpf(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_value *ucontrol
+){
+	struct ac10x_priv *priv = ac108_kcontrol_priv(kcontrol);
+	unsigned val = ucontrol->value.integer.value[0];
+
+	if (val > AC108_HPF_CUTOFF_MAX)
+		return -EINVAL;
+	if (val == priv->hpf_cutoff)
+		return 0;
+
+	priv->hpf_cutoff = val;
+	if (priv->hpf_rate)
+		ac108_set_hpf(priv, priv->hpf_rate);
+	return 1;
+}
+
+/*
+ * decimation filter profiles, ADC_DSR & ADC_FIR of all chips.
+ * [0] is the reset default, the others come from the board DT along
+ * with the group delay of every profile at every ADC rate, measured on
+ * the board; the register fields and the delays aren't documented.
+ */
+static int ac108_rate_index(unsigned rate) {
+	int i;
+
+	BUILD_BUG_ON(ARRAY_SIZE(ac108_sample_rate) != AC108_RATES);
+	for (i = 0; i < ARRAY_SIZE(ac108_sample_rate); i++) {
+		if (ac108_sample_rate[i].real_val == rate)
+			return i;
+	}
+	return -1;
+}
+
+static int ac108_set_dec_profile(struct ac10x_priv *ac10x) {
+	const struct ac108_dec_profile *p = &ac10x->dec_profile[ac10x->dec_sel];
+	int r;
+
+	/*0x63: ADC decimation sample rate select*/
+	r = ac108_multi_write(ADC_DSR, p->dsr, ac10x);
+	/*0x64: ADC decimation FIR select*/
+	r |= ac108_multi_write(ADC_FIR, p->fir, ac10x);
+	return r;
+}
+
+/* of the profile in use, in frames of the ADC rate, 0 - unknown or no rate yet */
+static unsigned ac108_group_delay(struct ac10x_priv *ac10x) {
+	int i = ac108_rate_index(ac10x->hpf_rate);
+
+	return i < 0 ? 0 : ac10x->dec_profile[ac10x->dec_sel].delay[i];
+}
+
+static int snd_ac108_info_dec_profile(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_info *uinfo
+){
+	struct ac10x_priv *priv = ac108_kcontrol_priv(kcontrol);
+
+	uinfo->type = SNDRV_CTL_ELEM_TYPE_INTEGER;
+	uinfo->count = 1;
+	uinfo->value.integer.min = 0;
+	uinfo->value.integer.max = priv->dec_profiles - 1;
+	return 0;
+}
+
+static int snd_ac108_get_dec_profile(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_value *ucontrol
+){
+	struct ac10x_priv *priv = ac108_kcontrol_priv(kcontrol);
+
+	ucontrol->value.integer.value[0] = priv->dec_sel;
+	return 0;
+}
+
+/* takes effect at once, a running stream sees the filter transient */
+static int snd_ac108_put_dec_profile(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_value *ucontrol
+){
+	struct ac10x_priv *priv = ac108_kcontrol_priv(kcontrol);
+	long val = ucontrol->value.integer.value[0];
+
+	if (val < 0 || val >= priv->dec_profiles)
+		return -EINVAL;
+	if (val == priv->dec_sel)
+		return 0;
+
+	priv->dec_sel = val;
+	ac108_set_dec_profile(priv);
+	return 1;
+}
+
+static int snd_ac108_info_group_delay(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_info *uinfo
+){
+	uinfo->type = SNDRV_CTL_ELEM_TYPE_INTEGER;
+	uinfo->count = 1;
+	uinfo->value.integer.min = 0;
+	uinfo->value.integer.max = U16_MAX;
+	return 0;
+}
+
+static int snd_ac108_get_group_delay(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_value *ucontrol
+){
+	struct ac10x_priv *priv = ac108_kcontrol_priv(kcontrol);
+
+	ucontrol->value.integer.value[0] = ac108_group_delay(priv);
+	return 0;
+}
+
+/*
+ * digital channel mixer, the same matrix for all chips
+ * 0x76-0x79 ADCn_DMIX_SRC: bit m - ADC(m+1) mixed into channel n,
+ * bit m+4 - ADC(m+1) -6dB.
+ */
+static int snd_ac108_get_dmix(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_value *ucontrol
+){
+	struct ac10x_priv *priv = ac108_kcontrol_priv(kcontrol);
+	struct soc_mixer_control *mc =
+		(struct soc_mixer_control *)kcontrol->private_value;
+
+	ucontrol->value.integer.value[0] = (priv->dmix_src[mc->reg - ADC1_DMIX_SRC] >> mc->shift) & 0x1;
+	return 0;
+}
+
+static int snd_ac108_put_dmix(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_value *ucontrol
+){
+	struct ac10x_priv *priv = ac108_kcontrol_priv(kcontrol);
+	struct soc_mixer_control *mc =
+		(struct soc_mixer_control *)kcontrol->private_value;
+	u8 *src = &priv->dmix_src[mc->reg - ADC1_DMIX_SRC];
+	u8 val = *src & ~(1 << mc->shift);
+
+	if (ucontrol->value.integer.value[0])
+		val |= 1 << mc->shift;
+	if (val == *src)
+		return 0;
+
+	*src = val;
+	ac108_multi_write(mc->reg, val, priv);
+	return 1;
+}
+
+#define SOC_AC108_DMIX(xname, reg, shift) \
+{	.iface = SNDRV_CTL_ELEM_IFACE_MIXER, .name = xname, \
+	.info = snd_soc_info_volsw, .get = snd_ac108_get_dmix,\
+	.put = snd_ac108_put_dmix, \
+	.private_value = SOC_SINGLE_VALUE(reg, shift, 1, 0, 0) }
+
+#define SOC_AC108_DMIX_CH(ch, reg) \
+	SOC_AC108_DMIX("CH" #ch " mix ADC1 switch", reg, 0), \
+	SOC_AC108_DMIX("CH" #ch " mix ADC2 switch", reg, 1), \
+	SOC_AC108_DMIX("CH" #ch " mix ADC3 switch", reg, 2), \
+	SOC_AC108_DMIX("CH" #ch " mix ADC4 switch", reg, 3), \
+	SOC_AC108_DMIX("CH" #ch " mix ADC1 -6dB switch", reg, 4), \
+	SOC_AC108_DMIX("CH" #ch " mix ADC2 -6dB switch", reg, 5), \
+	SOC_AC108_DMIX("CH" #ch " mix ADC3 -6dB switch", reg, 6), \
+	SOC_AC108_DMIX("CH" #ch " mix ADC4 -6dB switch", reg, 7)
+
+/* read only timings, in us */
+static int snd_ac108_info_us(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_info *uinfo
+){
+	uinfo->type = SNDRV_CTL_ELEM_TYPE_INTEGER;
+	uinfo->count = 1;
+	uinfo->value.integer.min = 0;
+	uinfo->value.integer.max = INT_MAX;
+	return 0;
+}
+
+/* runtime resume to first frame of the last resume */
+static int snd_ac108_get_resume_latency(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_value *ucontrol
+){
+	struct ac10x_priv *priv = ac108_kcontrol_priv(kcontrol);
+
+	ucontrol->value.integer.value[0] = priv->resume_latency_us;
+	return 0;
+}
+
+/* time spent writing registers back at the last resume, in us */
+static int snd_ac108_get_resume_sync(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_value *ucontrol
+){
+	struct ac10x_priv *priv = ac108_kcontrol_priv(kcontrol);
+
+	ucontrol->value.integer.value[0] = priv->resume_sync_us;
+	return 0;
+}
+
+/* time of the last DAPM power sequence, in us */
+static int snd_ac108_get_dapm_time(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_value *ucontrol
+){
+	struct ac10x_priv *priv = ac108_kcontrol_priv(kcontrol);
+
+	ucontrol->value.integer.value[0] = priv->dapm_us;
+	return 0;
+}
+
 #define SOC_AC108_SINGLE_TLV(xname, reg, shift, max, invert, chip, tlv_array) \
 {	.iface = SNDRV_CTL_ELEM_IFACE_MIXER, .name = xname, \
 	.access = SNDRV_CTL_ELEM_ACCESS_TLV_READ |\
@@ -273,6 +560,140 @@ static int snd_ac108_put_volsw(struct snd_kcontrol *kcontrol,
 	.put = snd_ac108_put_volsw, \
 	.private_value = SOC_SINGLE_VALUE(reg, shift, max, invert, chip) }
 
+/*
+ * ganged gains, one value per mic of all chips,
+ * each chip gets its 4 registers in one bulk write.
+ */
+#define AC108_GANG_DVOL		0	/* 0x70-0x73 ADC1-4_DVOL_CTRL */
+#define AC108_GANG_PGA		1	/* 0x90-0x93 ANA_PGA1-4_CTRL */
+
+static int snd_ac108_info_gang(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_info *uinfo
+){
+	struct ac10x_priv *priv = ac108_kcontrol_priv(kcontrol);
+
+	uinfo->type = SNDRV_CTL_ELEM_TYPE_INTEGER;
+	uinfo->count = 4 * priv->codec_cnt;
+	uinfo->value.integer.min = 0;
+	uinfo->value.integer.max = kcontrol->private_value == AC108_GANG_PGA ? 0x1f : 0xff;
+	return 0;
+}
+
+static int snd_ac108_get_gang(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_value *ucontrol
+){
+	struct ac10x_priv *priv = ac108_kcontrol_priv(kcontrol);
+	int pga = kcontrol->private_value == AC108_GANG_PGA;
+	int i, c;
+	u8 v;
+
+	for (i = 0; i < priv->codec_cnt; i++) {
+		for (c = 0; c < 4; c++) {
+			if (pga) {
+				ac10x_read(ANA_PGA1_CTRL + c, &v, priv->i2cmap[i]);
+				v = (v >> ADC1_ANALOG_PGA) & 0x1f;
+			} else {
+				ac10x_read(ADC1_DVOL_CTRL + c, &v, priv->i2cmap[i]);
+			}
+			ucontrol->value.integer.value[i * 4 + c] = v;
+		}
+	}
+	return 0;
+}
+
+/*
+ * all or nothing: every value is checked before the first write, a bus
+ * error or the apply limit on the way writes the chips done back.
+ * DAPM sequences queue writes of the same chips, they're kept out by
+ * the DAPM mutex. The limit counts from holding it and is checked before
+ * each chip, so an apply takes at most the limit plus one bulk write.
+ */
+#define AC108_GAIN_APPLY_LIMIT_US	5000
+
+static int snd_ac108_put_gang(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_value *ucontrol
+){
+	struct ac10x_priv *priv = ac108_kcontrol_priv(kcontrol);
+	struct snd_soc_dapm_context *dapm = snd_soc_codec_get_dapm(snd_soc_kcontrol_codec(kcontrol));
+	int pga = kcontrol->private_value == AC108_GANG_PGA;
+	u8 base = pga ? ANA_PGA1_CTRL : ADC1_DVOL_CTRL;
+	u8 old[4][4], val[4][4];
+	ktime_t t0;
+	int i, c, ret = 0, done, changed = 0;
+
+	for (i = 0; i < 4 * priv->codec_cnt; i++) {
+		long g = ucontrol->value.integer.value[i];
+
+		if (g < 0 || g > (pga ? 0x1f : 0xff))
+			return -EINVAL;
+	}
+
+	mutex_lock_nested(&dapm->card->dapm_mutex, SND_SOC_DAPM_CLASS_RUNTIME);
+	t0 = ktime_get();
+
+	for (i = 0; i < priv->codec_cnt; i++) {
+		ret = regmap_bulk_read(priv->i2cmap[i], base, old[i], sizeof(old[i]));
+		if (ret < 0)
+			goto out;
+		for (c = 0; c < 4; c++) {
+			long g = ucontrol->value.integer.value[i * 4 + c];
+
+			if (pga) {
+				val[i][c] = (old[i][c] & ~(0x1f << ADC1_ANALOG_PGA)) | g << ADC1_ANALOG_PGA;
+			} else {
+				val[i][c] = g;
+			}
+		}
+	}
+
+	for (done = 0; done < priv->codec_cnt; done++) {
+		if (!memcmp(old[done], val[done], sizeof(val[done])))
+			continue;
+		if (ktime_us_delta(ktime_get(), t0) > AC108_GAIN_APPLY_LIMIT_US) {
+			ret = -ETIMEDOUT;
+			break;
+		}
+		ret = ac10x_bulk_write(base, val[done], sizeof(val[done]), priv->i2cmap[done]);
+		if (ret < 0)
+			break;
+		changed = 1;
+	}
+	if (ret < 0) {
+		dev_err(dapm->dev, "gain apply error %d on chip %d, the chips before restored\n", ret, done);
+		while (--done >= 0) {
+			if (memcmp(old[done], val[done], sizeof(val[done])))
+				ac10x_bulk_write(base, old[done], sizeof(old[done]), priv->i2cmap[done]);
+		}
+		goto out;
+	}
+
+	priv->gain_apply_us = ktime_us_delta(ktime_get(), t0);
+	if (priv->gain_apply_us > priv->gain_apply_max_us)
+		priv->gain_apply_max_us = priv->gain_apply_us;
+	ret = changed;
+out:
+	mutex_unlock(&dapm->card->dapm_mutex);
+	return ret;
+}
+
+static int snd_ac108_get_gain_apply_max(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_value *ucontrol
+){
+	struct ac10x_priv *priv = ac108_kcontrol_priv(kcontrol);
+
+	ucontrol->value.integer.value[0] = priv->gain_apply_max_us;
+	return 0;
+}
+
+#define SOC_AC108_GANG_TLV(xname, gang, tlv_array) \
+{	.iface = SNDRV_CTL_ELEM_IFACE_MIXER, .name = xname, \
+	.access = SNDRV_CTL_ELEM_ACCESS_TLV_READ |\
+		 SNDRV_CTL_ELEM_ACCESS_READWRITE,\
+	.tlv.p = (tlv_array), \
+	.info = snd_ac108_info_gang, .get = snd_ac108_get_gang,\
+	.put = snd_ac108_put_gang, \
+	.private_value = gang }
+
 /* single ac108 */
 static const struct snd_kcontrol_new ac108_snd_controls[] = {
 	/* ### chip 0 ### */
@@ -293,9 +714,77 @@ static const struct snd_kcontrol_new ac108_snd_controls[] = {
 	SOC_AC108_SINGLE_TLV("ADC3 PGA gain", ANA_PGA3_CTRL, ADC3_ANALOG_PGA, 0x1f, 0, 0, tlv_adc_pga_gain),
 	/*0x93: Analog PGA4 Control Register*/
 	SOC_AC108_SINGLE_TLV("ADC4 PGA gain", ANA_PGA4_CTRL, ADC4_ANALOG_PGA, 0x1f, 0, 0, tlv_adc_pga_gain),
+
+	/*0x70-0x73 & 0x90-0x93 of all chips, ADC1-4 of chip 0 first*/
+	SOC_AC108_GANG_TLV("Array digital volume", AC108_GANG_DVOL, tlv_ch_digital_vol),
+	SOC_AC108_GANG_TLV("Array PGA gain", AC108_GANG_PGA, tlv_adc_pga_gain),
+	{	.iface = SNDRV_CTL_ELEM_IFACE_MIXER, .name = "Array gain apply max us",
+		.access = SNDRV_CTL_ELEM_ACCESS_READ | SNDRV_CTL_ELEM_ACCESS_VOLATILE,
+		.info = snd_ac108_info_us, .get = snd_ac108_get_gain_apply_max },
+
+	/*0x66-0x6E: HPF cutoff in Hz of all channels, 0 - off*/
+	{	.iface = SNDRV_CTL_ELEM_IFACE_MIXER, .name = "HPF cutoff",
+		.info = snd_ac108_info_hpf, .get = snd_ac108_get_hpf,
+		.put = snd_ac108_put_hpf },
+
+	/*0x63-0x64: decimation filter profile, its group delay in frames at the ADC rate*/
+	{	.iface = SNDRV_CTL_ELEM_IFACE_MIXER, .name = "ADC filter profile",
+		.info = snd_ac108_info_dec_profile, .get = snd_ac108_get_dec_profile,
+		.put = snd_ac108_put_dec_profile },
+	{	.iface = SNDRV_CTL_ELEM_IFACE_MIXER, .name = "ADC group delay",
+		.access = SNDRV_CTL_ELEM_ACCESS_READ | SNDRV_CTL_ELEM_ACCESS_VOLATILE,
+		.info = snd_ac108_info_group_delay, .get = snd_ac108_get_group_delay },
+
+	{	.iface = SNDRV_CTL_ELEM_IFACE_MIXER, .name = "Resume latency us",
+		.access = SNDRV_CTL_ELEM_ACCESS_READ | SNDRV_CTL_ELEM_ACCESS_VOLATILE,
+		.info = snd_ac108_info_us, .get = snd_ac108_get_resume_latency },
+	{	.iface = SNDRV_CTL_ELEM_IFACE_MIXER, .name = "Resume sync us",
+		.access = SNDRV_CTL_ELEM_ACCESS_READ | SNDRV_CTL_ELEM_ACCESS_VOLATILE,
+		.info = snd_ac108_info_us, .get = snd_ac108_get_resume_sync },
+	{	.iface = SNDRV_CTL_ELEM_IFACE_MIXER, .name = "DAPM sequence us",
+		.access = SNDRV_CTL_ELEM_ACCESS_READ | SNDRV_CTL_ELEM_ACCESS_VOLATILE,
+		.info = snd_ac108_info_us, .get = snd_ac108_get_dapm_time },
+
+	/*0x76: ADC1 Digital Mixer Source Control Register*/
+	SOC_AC108_DMIX_CH(1, ADC1_DMIX_SRC),
+	/*0x77: ADC2 Digital Mixer Source Control Register*/
+	SOC_AC108_DMIX_CH(2, ADC2_DMIX_SRC),
+	/*0x78: ADC3 Digital Mixer Source Control Register*/
+	SOC_AC108_DMIX_CH(3, ADC3_DMIX_SRC),
+	/*0x79: ADC4 Digital Mixer Source Control Register*/
+	SOC_AC108_DMIX_CH(4, ADC4_DMIX_SRC),
+};
+
+static int ac108_dapm_batch_event(struct snd_soc_dapm_widget *w,
+				  struct snd_kcontrol *kcontrol, int event);
+
+/* the second ac108, mics 5-8 */
+static const struct snd_kcontrol_new ac108_snd_controls_chip1[] = {
+	/* ### chip 1 ### */
+	/*0x70: ADC1 Digital Channel Volume Control Register*/
+	SOC_AC108_SINGLE_TLV("CH5 digital volume", ADC1_DVOL_CTRL, 0, 0xff, 0, 1, tlv_ch_digital_vol),
+	/*0x71: ADC2 Digital Channel Volume Control Register*/
+	SOC_AC108_SINGLE_TLV("CH6 digital volume", ADC2_DVOL_CTRL, 0, 0xff, 0, 1, tlv_ch_digital_vol),
+	/*0x72: ADC3 Digital Channel Volume Control Register*/
+	SOC_AC108_SINGLE_TLV("CH7 digital volume", ADC3_DVOL_CTRL, 0, 0xff, 0, 1, tlv_ch_digital_vol),
+	/*0x73: ADC4 Digital Channel Volume Control Register*/
+	SOC_AC108_SINGLE_TLV("CH8 digital volume", ADC4_DVOL_CTRL, 0, 0xff, 0, 1, tlv_ch_digital_vol),
+
+	/*0x90: Analog PGA1 Control Register*/
+	SOC_AC108_SINGLE_TLV("ADC5 PGA gain", ANA_PGA1_CTRL, ADC1_ANALOG_PGA, 0x1f, 0, 1, tlv_adc_pga_gain),
+	/*0x91: Analog PGA2 Control Register*/
+	SOC_AC108_SINGLE_TLV("ADC6 PGA gain", ANA_PGA2_CTRL, ADC2_ANALOG_PGA, 0x1f, 0, 1, tlv_adc_pga_gain),
+	/*0x92: Analog PGA3 Control Register*/
+	SOC_AC108_SINGLE_TLV("ADC7 PGA gain", ANA_PGA3_CTRL, ADC3_ANALOG_PGA, 0x1f, 0, 1, tlv_adc_pga_gain),
+	/*0x93: Analog PGA4 Control Register*/
+	SOC_AC108_SINGLE_TLV("ADC8 PGA gain", ANA_PGA4_CTRL, ADC4_ANALOG_PGA, 0x1f, 0, 1, tlv_adc_pga_gain),
 };
 
 static const struct snd_soc_dapm_widget ac108_dapm_widgets[] = {
+	/* DAPM runs PRE widgets first and POST widgets last in a sequence */
+	SND_SOC_DAPM_PRE("Batch begin", ac108_dapm_batch_event),
+	SND_SOC_DAPM_POST("Batch end", ac108_dapm_batch_event),
+
 	//input widgets
 	SND_SOC_DAPM_INPUT("MIC1P"),
 	SND_SOC_DAPM_INPUT("MIC1N"),
@@ -402,6 +891,22 @@ static const struct snd_soc_dapm_route ac108_dapm_routes[] = {
 
 };
 
+/* DMIC mode, the analog PGAs, modulators and micbias stay off */
+static const struct snd_soc_dapm_route ac108_dapm_dmic_routes[] = {
+
+	{ "ADC1", NULL, "DMIC1 enable" },
+	{ "ADC2", NULL, "DMIC1 enable" },
+	{ "ADC3", NULL, "DMIC2 enable" },
+	{ "ADC4", NULL, "DMIC2 enable" },
+
+	{ "DMIC1 enable", NULL, "ADC EN" },
+	{ "DMIC2 enable", NULL, "ADC EN" },
+
+	{ "DMIC1 enable", NULL, "DMIC1" },
+	{ "DMIC2 enable", NULL, "DMIC2" },
+
+};
+
 int ac108_multi_write(u8 reg, u8 val, struct ac10x_priv *ac10x) {
 	u8 i;
 	for (i = 0; i < ac10x->codec_cnt; i++) {
@@ -420,16 +925,89 @@ int ac108_multi_update_bits(u8 reg, u8 mask, u8 val, struct ac10x_priv *ac10x) {
 	return r;
 }
 
-// static unsigned int ac108_codec_read(struct snd_soc_codec *codec, unsigned int reg) {
-// 	unsigned char val_r;
-// 	struct ac10x_priv *ac10x = dev_get_drvdata(codec->dev);
-// 	/*read one chip is fine*/
-// 	ac10x_read(reg, &val_r, ac10x->i2cmap[_MASTER_INDEX]);
-// 	return val_r;
-// }
+/*
+ * DAPM power sequencing, the writes of one sequence are queued,
+ * consecutive writes to the same register merged, then each chip
+ * gets them in order with one regmap_multi_reg_write().
+ */
+static void ac108_dapm_batch_flush(struct ac10x_priv *ac10x) {
+	u64 t0;
+	int i, ret;
+
+	for (i = 0; i < ac10x->codec_cnt && ac10x->dapm_batch_cnt; i++) {
+		t0 = trace_ac108_reg_multi_write_enabled() ? ktime_get_ns() : 0;
+		ret = regmap_multi_reg_write(ac10x->i2cmap[i], ac10x->dapm_seq, ac10x->dapm_batch_cnt);
+		if (ret < 0) {
+			pr_err("%s() i2cmap%d error %d\n", __func__, i, ret);
+		}
+		trace_ac108_reg_multi_write(ac10x->i2cmap[i], ac10x->dapm_seq[0].reg, ac10x->dapm_batch_cnt,
+					    ret, t0 ? ktime_get_ns() - t0 : 0);
+	}
+	ac10x->dapm_batch_cnt = 0;
+}
+
+static void ac108_dapm_batch_write(struct ac10x_priv *ac10x, unsigned int reg, unsigned int val) {
+	int n = ac10x->dapm_batch_cnt;
+
+	if (n && ac10x->dapm_seq[n - 1].reg == reg) {
+		ac10x->dapm_seq[n - 1].def = val;
+		return;
+	}
+	if (ac10x->dapm_batch_cnt >= AC108_DAPM_BATCH_MAX) {
+		ac108_dapm_batch_flush(ac10x);
+	}
+	ac10x->dapm_seq[ac10x->dapm_batch_cnt].reg = reg;
+	ac10x->dapm_seq[ac10x->dapm_batch_cnt].def = val;
+	ac10x->dapm_seq[ac10x->dapm_batch_cnt].delay_us = 0;
+	ac10x->dapm_batch_cnt++;
+}
+
+static int ac108_dapm_batch_event(struct snd_soc_dapm_widget *w,
+				  struct snd_kcontrol *kcontrol, int event) {
+	struct ac10x_priv *ac10x = dev_get_drvdata(w->dapm->dev);
+
+	switch (event) {
+	case SND_SOC_DAPM_PRE_PMU:
+	case SND_SOC_DAPM_PRE_PMD:
+		ac10x->dapm_ts = ktime_get();
+		ac10x->dapm_batch_cnt = 0;
+		ac10x->dapm_batch = 1;
+		break;
+	case SND_SOC_DAPM_POST_PMU:
+	case SND_SOC_DAPM_POST_PMD:
+		ac108_dapm_batch_flush(ac10x);
+		ac10x->dapm_batch = 0;
+		ac10x->dapm_us = ktime_us_delta(ktime_get(), ac10x->dapm_ts);
+		dev_dbg(w->dapm->dev, "DAPM %s %uus\n",
+			event == SND_SOC_DAPM_POST_PMU ? "up" : "down", ac10x->dapm_us);
+		break;
+	}
+	return 0;
+}
+
+static unsigned int ac108_codec_read(struct snd_soc_codec *codec, unsigned int reg) {
+	unsigned char val_r;
+	struct ac10x_priv *ac10x = dev_get_drvdata(codec->dev);
+	int i;
+
+	/* a queued value is newer than the chip */
+	for (i = ac10x->dapm_batch ? ac10x->dapm_batch_cnt - 1 : -1; i >= 0; i--) {
+		if (ac10x->dapm_seq[i].reg == reg)
+			return ac10x->dapm_seq[i].def;
+	}
+
+	/*read one chip is fine*/
+	ac10x_read(reg, &val_r, ac10x->i2cmap[_MASTER_INDEX]);
+	return val_r;
+}
 
 int ac108_codec_write(struct snd_soc_codec *codec, unsigned int reg, unsigned int val) {
 	struct ac10x_priv *ac10x = dev_get_drvdata(codec->dev);
+
+	if (ac10x->dapm_batch) {
+		ac108_dapm_batch_write(ac10x, reg, val);
+		return 0;
+	}
 	ac108_multi_write(reg, val, ac10x);
 	return 0;
 }
@@ -479,6 +1057,7 @@ void ac108_configure_power(struct ac10x_priv *ac10x) {
 int ac108_config_pll(struct ac10x_priv *ac10x, unsigned rate, unsigned lrck_ratio) {
 	unsigned int i = 0;
 	struct pll_div ac108_pll_div = { 0 };
+	int ret = 0;
 
 	if (ac10x->clk_id == SYSCLK_SRC_PLL) {
 		unsigned pll_src, pll_freq_in;
@@ -502,6 +1081,11 @@ int ac108_config_pll(struct ac10x_priv *ac10x, unsigned rate, unsigned lrck_rati
 				break;
 			}
 		}
+		if (i >= ARRAY_SIZE(ac108_pll_div_list)) {
+			dev_warn(&ac10x->i2c[_MASTER_INDEX]->dev, "AC108 no PLL divider for %s %u, rate %u\n",
+				 pll_src ? "BCLK" : "MCLK", pll_freq_in, rate);
+			ret = -EINVAL;
+		}
 		/* 0x11,0x12,0x13,0x14: Config PLL DIV param M1/M2/N/K1/K2 */
 		ac108_multi_update_bits(PLL_CTRL5, 0x1f << PLL_POSTDIV1 | 0x01 << PLL_POSTDIV2,
 						   ac108_pll_div.k1 << PLL_POSTDIV1 | ac108_pll_div.k2 << PLL_POSTDIV2, ac10x);
@@ -529,15 +1113,57 @@ int ac108_config_pll(struct ac10x_priv *ac10x, unsigned rate, unsigned lrck_rati
 		ac10x->mclk = ac10x->sysclk;
 	}
 
-	return 0;
+	return ret;
 }
 
 /*
  * support no more than 16 slots.
  */
+/* chips of the whole array, a per chip component is one of them */
+static int ac108_array_chips(void) {
+	return ac10x->codec_cnt;
+}
+
+/*
+ * the mixer has summed the ADCs into the first dmix_channels digital channels,
+ * only those of each chip go to TDM slots.
+ */
+static int ac108_dmix_chips_slots(struct ac10x_priv *ac, int slots) {
+	int i, c;
+
+	for (i = 0; i < ac->codec_cnt; i++) {
+		int chip = ac->chip_index + i;
+		unsigned mask = 0, map = 0;
+
+		for (c = 0; c < ac->dmix_channels; c++) {
+			/* rotate map by 2 slots, due to channels rotated by CPU_DAI */
+			int slot = (chip * ac->dmix_channels + c + slots - 2) % slots;
+
+			mask |= 1 << slot;
+			map  |= c << (slot * 2);
+		}
+
+		/* 0x38-0x3A I2S_TX1_CTRLx */
+		ac10x_write(I2S_TX1_CTRL1, slots - 1, ac->i2cmap[i]);
+		ac10x_write(I2S_TX1_CTRL2, (mask >> 0) & 0xFF, ac->i2cmap[i]);
+		ac10x_write(I2S_TX1_CTRL3, (mask >> 8) & 0xFF, ac->i2cmap[i]);
+
+		/* 0x3C-0x3F I2S_TX1_CHMP_CTRLx */
+		ac10x_write(I2S_TX1_CHMP_CTRL1, (map >>  0) & 0xFF, ac->i2cmap[i]);
+		ac10x_write(I2S_TX1_CHMP_CTRL2, (map >>  8) & 0xFF, ac->i2cmap[i]);
+		ac10x_write(I2S_TX1_CHMP_CTRL3, (map >> 16) & 0xFF, ac->i2cmap[i]);
+		ac10x_write(I2S_TX1_CHMP_CTRL4, (map >> 24) & 0xFF, ac->i2cmap[i]);
+	}
+	return 0;
+}
+
 static int ac108_multi_chips_slots(struct ac10x_priv *ac, int slots) {
 	int i;
 
+	if (ac->dmix_channels < 4) {
+		return ac108_dmix_chips_slots(ac, slots);
+	}
+
 	/*
 	 * codec0 enable slots 2,3,0,1 when 1 codec
 	 *
@@ -545,8 +1171,10 @@ static int ac108_multi_chips_slots(struct ac10x_priv *ac, int slots) {
 	 * codec1 enable slots 2,3,4,5
 	 *
 	 * ...
+	 * numbered in the whole array, a per chip component has one of them.
 	 */
 	for (i = 0; i < ac->codec_cnt; i++) {
+		int chip = ac->chip_index + i, chips = ac10x->codec_cnt;
 		/* rotate map, due to channels rotated by CPU_DAI */
 		const unsigned vec_mask[] = {
 			0x3 << 6 | 0x3,	// slots 6,7,0,1
@@ -577,20 +1205,20 @@ static int ac108_multi_chips_slots(struct ac10x_priv *ac, int slots) {
 		unsigned vec;
 
 		/* 0x38-0x3A I2S_TX1_CTRLx */
-		if (ac->codec_cnt == 1) {
+		if (chips == 1) {
 			vec = 0xFUL;
 		} else {
-			vec = vec_mask[i];
+			vec = vec_mask[chip];
 		}
 		ac10x_write(I2S_TX1_CTRL1, slots - 1, ac->i2cmap[i]);
 		ac10x_write(I2S_TX1_CTRL2, (vec >> 0) & 0xFF, ac->i2cmap[i]);
 		ac10x_write(I2S_TX1_CTRL3, (vec >> 8) & 0xFF, ac->i2cmap[i]);
 
 		/* 0x3C-0x3F I2S_TX1_CHMP_CTRLx */
-		if (ac->codec_cnt == 1) {
+		if (chips == 1) {
 			vec = (0x2 << 0 | 0x3 << 2 | 0x0 << 4 | 0x1 << 6);
-		} else if (ac->codec_cnt == 2) {
-			vec = vec_maps[i];
+		} else if (chips == 2) {
+			vec = vec_maps[chip];
 		}
 
 		ac10x_write(I2S_TX1_CHMP_CTRL1, (vec >>  0) & 0xFF, ac->i2cmap[i]);
@@ -601,38 +1229,168 @@ static int ac108_multi_chips_slots(struct ac10x_priv *ac, int slots) {
 	return 0;
 }
 
-int ac108_hw_params(struct snd_pcm_substream *substream, struct snd_pcm_hw_params *params, struct snd_soc_dai *dai) {
-	unsigned int i, channels, samp_res, rate, div;
+/*
+ * PDM mics on DMIC1/DMIC2 feed the ADC digital part directly,
+ * the DMIC clock is derived from the ADC clock, so follows the rate.
+ */
+static void ac108_dmic_config(struct ac10x_priv *ac10x) {
+	int i;
+
+	if (ac10x->dmic_gpio_cfg) {
+		/*0xC0-0xC1: pins of DMIC clock & data*/
+		ac108_multi_write(GPIO_CFG1, ac10x->gpio_cfg[0], ac10x);
+		ac108_multi_write(GPIO_CFG2, ac10x->gpio_cfg[1], ac10x);
+	}
+
+	/*0xA0,0xA7,0xAE,0xB5: PGA, modulator and micbias of ADC1-4 off*/
+	for (i = 0; i < 4; i++) {
+		ac108_multi_update_bits(ANA_ADC1_CTRL1 + i * (ANA_ADC2_CTRL1 - ANA_ADC1_CTRL1),
+					0x01 << ADC1_DSM_ENABLE | 0x01 << ADC1_PGA_ENABLE | 0x01 << ADC1_MICBIAS_EN,
+					0x00, ac10x);
+	}
+	/*0xBB: analog ADC clocks gated*/
+	ac108_multi_update_bits(ANA_ADC4_CTRL7, 0x0F << ADC1_CLK_GATING, 0x00, ac10x);
+
+	/*0x62: DMIC1/DMIC2 enable*/
+	ac108_multi_write(DMIC_EN, ac10x->dmic_en, ac10x);
+}
+
+/*
+ * Full duplex, both directions run on the same BCLK/LRCK.
+ * The first configured direction owns the bus plan (rate, slot width, slots),
+ * hw rules refine the other direction to the same plan, so its hw_params
+ * can't ask for another bus and nothing has to be restarted.
+ */
+static int ac108_duplex_refine(struct snd_pcm_hw_params *params, int var, unsigned v) {
+	struct snd_interval t;
+
+	snd_interval_any(&t);
+	t.min = t.max = v;
+	t.integer = 1;
+	return snd_interval_refine(hw_param_interval(params, var), &t);
+}
+
+static int ac108_duplex_rule_rate(struct snd_pcm_hw_params *params,
+				  struct snd_pcm_hw_rule *rule) {
+	struct ac10x_plan *plan = rule->private;
+
+	if (!plan->rate)
+		return 0;
+	return ac108_duplex_refine(params, SNDRV_PCM_HW_PARAM_RATE, plan->rate);
+}
+
+static int ac108_duplex_rule_channels(struct snd_pcm_hw_params *params,
+				      struct snd_pcm_hw_rule *rule) {
+	struct ac10x_plan *plan = rule->private;
+
+	if (!plan->rate)
+		return 0;
+	return ac108_duplex_refine(params, SNDRV_PCM_HW_PARAM_CHANNELS, plan->channels);
+}
+
+static int ac108_duplex_rule_format(struct snd_pcm_hw_params *params,
+				    struct snd_pcm_hw_rule *rule) {
+	struct ac10x_plan *plan = rule->private;
+	struct snd_mask m;
+
+	if (!plan->rate)
+		return 0;
+	snd_mask_none(&m);
+	snd_mask_set(&m, (__force unsigned)plan->format);
+	return snd_mask_refine(hw_param_mask(params, SNDRV_PCM_HW_PARAM_FORMAT), &m);
+}
+
+/* rules read the plan at refine time, the other direction may be configured after this open */
+static int ac108_duplex_constraints(struct ac10x_priv *ac10x, struct snd_pcm_substream *substream) {
+	struct snd_pcm_runtime *runtime = substream->runtime;
+	struct ac10x_plan *other = &ac10x->plan[substream->stream == SNDRV_PCM_STREAM_PLAYBACK ?
+						SNDRV_PCM_STREAM_CAPTURE : SNDRV_PCM_STREAM_PLAYBACK];
+	int ret;
+
+	ret = snd_pcm_hw_rule_add(runtime, 0, SNDRV_PCM_HW_PARAM_RATE,
+				  ac108_duplex_rule_rate, other,
+				  SNDRV_PCM_HW_PARAM_RATE, -1);
+	if (ret < 0)
+		return ret;
+
+	ret = snd_pcm_hw_rule_add(runtime, 0, SNDRV_PCM_HW_PARAM_CHANNELS,
+				  ac108_duplex_rule_channels, other,
+				  SNDRV_PCM_HW_PARAM_CHANNELS, -1);
+	if (ret < 0)
+		return ret;
+
+	return snd_pcm_hw_rule_add(runtime, 0, SNDRV_PCM_HW_PARAM_FORMAT,
+				   ac108_duplex_rule_format, other,
+				   SNDRV_PCM_HW_PARAM_FORMAT, -1);
+}
+
+/* hw_params of the second direction, the bus is already running its plan */
+int ac108_duplex_check(struct ac10x_priv *ac10x, struct snd_pcm_substream *substream,
+		       struct snd_pcm_hw_params *params) {
+	struct ac10x_plan *other = &ac10x->plan[substream->stream == SNDRV_PCM_STREAM_PLAYBACK ?
+						SNDRV_PCM_STREAM_CAPTURE : SNDRV_PCM_STREAM_PLAYBACK];
+
+	if (params_rate(params) != other->rate
+	 || params_channels(params) != other->channels
+	 || params_format(params) != other->format) {
+		pr_err("AC108 %s %uHz %uch fmt %d, bus runs %uHz %uch fmt %d\n",
+			snd_pcm_stream_str(substream),
+			params_rate(params), params_channels(params), params_format(params),
+			other->rate, other->channels, other->format);
+		return -EINVAL;
+	}
+
+	ac10x->plan[substream->stream] = *other;
+	return 0;
+}
+
+/*
+ * codec slave, PLL (from BCLK) and global clock are left on from
+ * hw_params to shutdown, the SoC starts and stops the bus.
+ */
+static void ac108_slave_clock(struct ac10x_priv *ac10x, int on) {
+	if (!!on == !!ac10x->sysclk_en)
+		return;
+
+	/*0x10: PLL Common voltage, PLL */
+	ac108_multi_update_bits(PLL_CTRL1, 0x01 << PLL_EN | 0x01 << PLL_COM_EN,
+				(!!on) << PLL_EN | (!!on) << PLL_COM_EN, ac10x);
+	/*0x30: global clock, transmitter */
+	ac108_multi_update_bits(I2S_CTRL, 0x1 << TXEN | 0x1 << GEN, (!!on) << TXEN | (!!on) << GEN, ac10x);
+	ac10x->sysclk_en = !!on;
+}
+
+static int __ac108_hw_params(struct snd_pcm_substream *substream, struct snd_pcm_hw_params *params, struct snd_soc_dai *dai) {
+	unsigned int i, channels, samp_res, rate, div;
 	struct snd_soc_codec *codec = dai->codec;
 	struct ac10x_priv *ac10x = snd_soc_codec_get_drvdata(codec);
 	unsigned bclkdiv;
-	u8 reg;
 	u8 v;
 
 	dev_dbg(dai->dev, "%s() stream=%s play:%d capt:%d +++\n", __func__,
 			snd_pcm_stream_str(substream),
 			dai->stream_active[SNDRV_PCM_STREAM_PLAYBACK], dai->stream_active[SNDRV_PCM_STREAM_CAPTURE]);
 
-	if ((substream->stream == SNDRV_PCM_STREAM_CAPTURE && dai->stream_active[SNDRV_PCM_STREAM_PLAYBACK])
-	 || (substream->stream == SNDRV_PCM_STREAM_PLAYBACK && dai->stream_active[SNDRV_PCM_STREAM_CAPTURE])) {
+	if ((substream->stream == SNDRV_PCM_STREAM_CAPTURE && ac10x->plan[SNDRV_PCM_STREAM_PLAYBACK].rate)
+	 || (substream->stream == SNDRV_PCM_STREAM_PLAYBACK && ac10x->plan[SNDRV_PCM_STREAM_CAPTURE].rate)) {
 		/* not configure hw_param twice */
-		int current_bclkdiv=0;
-		
-		ac10x_read(I2S_BCLK_CTRL, &reg, ac10x->i2cmap[_MASTER_INDEX]);
-		current_bclkdiv = ac108_bclkdivs[(reg & 0x0f) ];
-
-		if (ac10x->mclk/current_bclkdiv/params_rate(params)/params_channels(params)/ac108_samp_res[samp_res].real_val != 1) {
-			return -EINVAL;
-		}
-		else{
-			return 0;
-		}
+		return ac108_duplex_check(ac10x, substream, params);
 	}
 	else {
 		channels = params_channels(params);
 
+		if (ac10x->dmix_channels < 4 && channels != ac10x->dmix_channels * ac108_array_chips()) {
+			pr_err("AC108 %u channels, %d chips with %d mixed channels each\n",
+				channels, ac108_array_chips(), ac10x->dmix_channels);
+			return -EINVAL;
+		}
+
 		/* Master mode, to clear cpu_dai fifos, output bclk without lrck */
-		ac10x_read(I2S_CTRL, &v, ac10x->i2cmap[_MASTER_INDEX]);
+		if (ac10x->i2s_master) {
+			ac10x_read(I2S_CTRL, &v, ac10x->i2cmap[_MASTER_INDEX]);
+		} else {
+			v = 0;
+		}
 		if (v & (0x01 << BCLK_IOEN)) {
 			ac10x_update_bits(I2S_CTRL, 0x1 << LRCK_IOEN, 0x0 << LRCK_IOEN, ac10x->i2cmap[_MASTER_INDEX]);
 		}
@@ -727,31 +1485,66 @@ int ac108_hw_params(struct snd_pcm_substream *substream, struct snd_pcm_hw_param
 		* ADC Sample Rate synchronised with I2S1 clock zone 
 		*/
 		ac108_multi_update_bits(ADC_SPRC, 0x0f << ADC_FS_I2S1, ac108_sample_rate[rate].reg_val << ADC_FS_I2S1, ac10x);
-		ac108_multi_write(HPF_EN, 0x0F, ac10x);
+		ac108_set_hpf(ac10x, ac108_sample_rate[rate].real_val);
+		ac108_set_dec_profile(ac10x);
+
+		/*0x76-0x79: digital mixer of ADC1-4*/
+		for (i = 0; i < ARRAY_SIZE(ac10x->dmix_src); i++) {
+			ac108_multi_write(ADC1_DMIX_SRC + i, ac10x->dmix_src[i], ac10x);
+		}
 
-		ac108_config_pll(ac10x, ac108_sample_rate[rate].real_val, ac108_samp_res[samp_res].real_val * channels);
+		/*
+		* slave mode: the SoC runs a frame of channels * slot width BCLKs,
+		* nothing else to lock the PLL to
+		*/
+		if (ac108_config_pll(ac10x, ac108_sample_rate[rate].real_val, ac108_samp_res[samp_res].real_val * channels) < 0
+		 && !ac10x->i2s_master) {
+			return -EINVAL;
+		}
 
 		/*
 		* master mode only
 		*/
-		bclkdiv = ac10x->mclk / (ac108_sample_rate[rate].real_val * channels * ac108_samp_res[samp_res].real_val);
-		for (i = 0; i < ARRAY_SIZE(ac108_bclkdivs) - 1; i++) {
-			if (ac108_bclkdivs[i] >= bclkdiv) {
-				break;
+		if (ac10x->i2s_master) {
+			bclkdiv = ac10x->mclk / (ac108_sample_rate[rate].real_val * channels * ac108_samp_res[samp_res].real_val);
+			for (i = 0; i < ARRAY_SIZE(ac108_bclkdivs) - 1; i++) {
+				if (ac108_bclkdivs[i] >= bclkdiv) {
+					break;
+				}
 			}
+			ac108_multi_update_bits(I2S_BCLK_CTRL, 0x0F << BCLKDIV, i << BCLKDIV, ac10x);
 		}
-		ac108_multi_update_bits(I2S_BCLK_CTRL, 0x0F << BCLKDIV, i << BCLKDIV, ac10x);
 
 		/*
 		* slots allocation for each chip
 		*/
 		ac108_multi_chips_slots(ac10x, channels);
 
-		/*0x21: Module clock enable<I2S, ADC digital, MIC offset Calibration, ADC analog>*/
-		ac108_multi_write(MOD_CLK_EN, 1 << I2S | 1 << ADC_DIGITAL | 1 << MIC_OFFSET_CALIBRATION | 1 << ADC_ANALOG, ac10x);
-		/*0x22: Module reset de-asserted<I2S, ADC digital, MIC offset Calibration, ADC analog>*/
-		ac108_multi_write(MOD_RST_CTRL, 1 << I2S | 1 << ADC_DIGITAL | 1 << MIC_OFFSET_CALIBRATION | 1 << ADC_ANALOG, ac10x);
+		ac10x->plan[substream->stream].rate = params_rate(params);
+		ac10x->plan[substream->stream].channels = channels;
+		ac10x->plan[substream->stream].format = params_format(params);
+
+		if (ac10x->dmic_en) {
+			ac108_dmic_config(ac10x);
+
+			/*0x21: Module clock enable<I2S, ADC digital>*/
+			ac108_multi_write(MOD_CLK_EN, 1 << I2S | 1 << ADC_DIGITAL, ac10x);
+			/*0x22: Module reset de-asserted<I2S, ADC digital>*/
+			ac108_multi_write(MOD_RST_CTRL, 1 << I2S | 1 << ADC_DIGITAL, ac10x);
+		} else {
+			/*0x21: Module clock enable<I2S, ADC digital, MIC offset Calibration, ADC analog>*/
+			ac108_multi_write(MOD_CLK_EN, 1 << I2S | 1 << ADC_DIGITAL | 1 << MIC_OFFSET_CALIBRATION | 1 << ADC_ANALOG, ac10x);
+			/*0x22: Module reset de-asserted<I2S, ADC digital, MIC offset Calibration, ADC analog>*/
+			ac108_multi_write(MOD_RST_CTRL, 1 << I2S | 1 << ADC_DIGITAL | 1 << MIC_OFFSET_CALIBRATION | 1 << ADC_ANALOG, ac10x);
+		}
 
+		/*
+		* slave mode, the chips start with the first BCLK/LRCK of the SoC,
+		* no clock sequencing at trigger time
+		*/
+		if (!ac10x->i2s_master) {
+			ac108_slave_clock(ac10x, 1);
+		}
 
 		dev_dbg(dai->dev, "%s() stream=%s ---\n", __func__,
 				snd_pcm_stream_str(substream));
@@ -760,6 +1553,19 @@ int ac108_hw_params(struct snd_pcm_substream *substream, struct snd_pcm_hw_param
 	}
 }
 
+/* timed entry point, free while the ac108 events are disabled */
+int ac108_hw_params(struct snd_pcm_substream *substream, struct snd_pcm_hw_params *params, struct snd_soc_dai *dai) {
+	struct ac10x_priv *ac10x = dev_get_drvdata(dai->dev);
+	u64 t0 = trace_ac108_hw_params_enabled() ? ktime_get_ns() : 0;
+	int ret;
+
+	ret = __ac108_hw_params(substream, params, dai);
+	trace_ac108_hw_params(ac10x->chip_index, substream->stream, params_rate(params),
+			      params_channels(params), (__force int)params_format(params), ret,
+			      t0 ? ktime_get_ns() - t0 : 0);
+	return ret;
+}
+
 int ac108_set_sysclk(struct snd_soc_dai *dai, int clk_id, unsigned int freq, int dir) {
 
 	struct ac10x_priv *ac10x = snd_soc_dai_get_drvdata(dai);
@@ -800,7 +1606,7 @@ int ac108_set_sysclk(struct snd_soc_dai *dai, int clk_id, unsigned int freq, int
  * 
  * @return int 
  */
-int ac108_set_fmt(struct snd_soc_dai *dai, unsigned int fmt) {
+static int __ac108_set_fmt(struct snd_soc_dai *dai, unsigned int fmt) {
 	unsigned char tx_offset, lrck_polarity, brck_polarity;
 	struct ac10x_priv *ac10x = dev_get_drvdata(dai->dev);
 
@@ -813,17 +1619,21 @@ int ac108_set_fmt(struct snd_soc_dai *dai, unsigned int fmt) {
 		switch (fmt & SND_SOC_DAIFMT_MASTER_MASK) {
 		case SND_SOC_DAIFMT_CBM_CFM:    /*AC108 Master*/
 			dev_dbg(dai->dev, "AC108 set to work as Master\n");
+			ac10x->i2s_master = 1;
 			/**
 			* 0x30:chip is master mode ,BCLK & LRCK output
 			*/
 			ac108_multi_update_bits(I2S_CTRL, 0x03 << LRCK_IOEN | 0x03 << SDO1_EN | 0x1 << TXEN | 0x1 << GEN,
 							0x00 << LRCK_IOEN | 0x03 << SDO1_EN | 0x1 << TXEN | 0x1 << GEN, ac10x);
 			/* multi_chips: only one chip set as Master, and the others also need to set as Slave */
-			ac10x_update_bits(I2S_CTRL, 0x3 << LRCK_IOEN, 0x01 << BCLK_IOEN, ac10x->i2cmap[_MASTER_INDEX]);
+			if (ac10x->chip_index == _MASTER_INDEX) {
+				ac10x_update_bits(I2S_CTRL, 0x3 << LRCK_IOEN, 0x01 << BCLK_IOEN, ac10x->i2cmap[_MASTER_INDEX]);
+			}
 			break;
 			fallthrough;
 		case SND_SOC_DAIFMT_CBS_CFS:    /*AC108 Slave*/
 			dev_dbg(dai->dev, "AC108 set to work as Slave\n");
+			ac10x->i2s_master = 0;
 			/**
 			* 0x30:chip is slave mode, BCLK & LRCK input,enable SDO1_EN and 
 			*  SDO2_EN, Transmitter Block Enable, Globe Enable
@@ -939,17 +1749,101 @@ int ac108_set_fmt(struct snd_soc_dai *dai, unsigned int fmt) {
 	}
 }
 
+int ac108_set_fmt(struct snd_soc_dai *dai, unsigned int fmt) {
+	struct ac10x_priv *ac10x = dev_get_drvdata(dai->dev);
+	u64 t0 = trace_ac108_set_fmt_enabled() ? ktime_get_ns() : 0;
+	int ret;
+
+	ret = __ac108_set_fmt(dai, fmt);
+	trace_ac108_set_fmt(ac10x->chip_index, fmt, ac10x->i2s_master, ret,
+			    t0 ? ktime_get_ns() - t0 : 0);
+	return ret;
+}
+
+static struct snd_soc_dai_driver ac108_dai[4];
+
+/*
+ * the chips a set_clock() dai belongs to, the clock handle of its card,
+ * NULL for the codec of another card, the array if no dai is given.
+ */
+static struct ac10x_priv *ac108_clock_priv(struct snd_soc_dai *dai) {
+	struct ac10x_priv *ac;
+	int i;
+
+	if (!dai)
+		return ac10x;
+	if (dai->driver < ac108_dai || dai->driver >= ac108_dai + ARRAY_SIZE(ac108_dai))
+		return NULL;
+	/* a per chip component stands for the array it was split from */
+	ac = dev_get_drvdata(dai->dev);
+	for (i = 0; ac10x && i < ARRAY_SIZE(ac10x->chip); i++) {
+		if (ac10x->chip[i] == ac)
+			return ac10x;
+	}
+	return ac;
+}
+
 /*
  * due to miss channels order in cpu_dai, we meed defer the clock starting.
  */
-int ac108_set_clock(int y_start_n_stop, struct snd_pcm_substream *substream, int cmd, struct snd_soc_dai *dai) {
+static int __ac108_set_clock(int y_start_n_stop, struct snd_pcm_substream *substream, int cmd, struct snd_soc_dai *dai) {
+	struct ac10x_priv *ac10x = ac108_clock_priv(dai);
+	struct ac10x_priv *master;
 	u8 reg;
-	int ret = 0;
+	int i, ret = 0;
+
+	/* not our codec */
+	if (!ac10x) {
+		return 0;
+	}
+	master = ac10x->chip[_MASTER_INDEX] ? ac10x->chip[_MASTER_INDEX] : ac10x;
 
 	dev_dbg(ac10x->codec->dev, "%s() L%d cmd:%d\n", __func__, __LINE__, y_start_n_stop);
 
+	/* no register access, the clock as it is before a start */
+	if (y_start_n_stop == AC10X_CLOCK_STATE) {
+		return master->i2s_master ? ac10x->sysclk_en : master->sysclk_en;
+	}
+
+	/* slave mode, clocked by the SoC, see ac108_slave_clock() */
+	if (!master->i2s_master) {
+		return 0;
+	}
+
 	/* spin_lock move to machine trigger */
 
+	if (y_start_n_stop == AC10X_CLOCK_XRUN) {
+		if (ac10x->sysclk_en != 1) {
+			return 0;
+		}
+		/*
+		 * overrun, gate LRCK of the master, BCLK keeps the cpu_dai FIFO
+		 * draining and the chips' TX restarts at slot 0 of the next frame
+		 */
+		ac10x_read(I2S_CTRL, &reg, ac10x->i2cmap[_MASTER_INDEX]);
+		if (reg & (0x01 << LRCK_IOEN)) {
+			ret = ac10x_update_bits(I2S_CTRL, 0x1 << LRCK_IOEN, 0x0 << LRCK_IOEN, ac10x->i2cmap[_MASTER_INDEX]);
+		}
+		if (!ret) {
+			ac10x->sysclk_en = AC10X_CLOCK_XRUN;
+		}
+		return ret;
+	}
+
+	if (y_start_n_stop && ac10x->sysclk_en == AC10X_CLOCK_XRUN) {
+		/* PLL still locked, global clock (cached, no write if on) and LRCK back */
+		ret = ac108_multi_update_bits(I2S_CTRL, 0x1 << TXEN | 0x1 << GEN, 0x1 << TXEN | 0x1 << GEN, ac10x);
+		if (ret < 0) {
+			return ret;
+		}
+		ret = ac10x_update_bits(I2S_CTRL, 0x03 << LRCK_IOEN, 0x03 << LRCK_IOEN, ac10x->i2cmap[_MASTER_INDEX]);
+		if (ret < 0) {
+			return ret;
+		}
+		ac10x->sysclk_en = 1UL;
+		return 0;
+	}
+
 	if (y_start_n_stop && ac10x->sysclk_en == 0) {
 		/* enable lrck clock */
 		ac10x_read(I2S_CTRL, &reg, ac10x->i2cmap[_MASTER_INDEX]);
@@ -964,6 +1858,17 @@ int ac108_set_clock(int y_start_n_stop, struct snd_pcm_substream *substream, int
 		ret = ret || ac108_multi_update_bits(I2S_CTRL, 0x1 << TXEN | 0x1 << GEN, 0x1 << TXEN | 0x1 << GEN, ac10x);
 
 		ac10x->sysclk_en = 1UL;
+
+		/* runtime resume to first frame, of the array or of each chip component */
+		for (i = -1; i < (int)ARRAY_SIZE(ac10x->chip); i++) {
+			struct ac10x_priv *ac = i < 0 ? ac10x : ac10x->chip[i];
+
+			if (!ac || !ac->resume_ts)
+				continue;
+			ac->resume_latency_us = ktime_us_delta(ktime_get(), ac->resume_ts);
+			ac->resume_ts = 0;
+			dev_dbg(&ac->i2c[_MASTER_INDEX]->dev, "runtime resume to first frame %uus\n", ac->resume_latency_us);
+		}
 	} else if (!y_start_n_stop && ac10x->sysclk_en != 0) {
 		/* disable global clock */
 		ret = ret || ac108_multi_update_bits(I2S_CTRL, 0x1 << TXEN | 0x1 << GEN, 0x0 << TXEN | 0x0 << GEN, ac10x);
@@ -985,6 +1890,90 @@ int ac108_set_clock(int y_start_n_stop, struct snd_pcm_substream *substream, int
 	return ret;
 }
 
+int ac108_set_clock(int y_start_n_stop, struct snd_pcm_substream *substream, int cmd, struct snd_soc_dai *dai) {
+	struct ac10x_priv *ac = ac108_clock_priv(dai);
+	u64 t0 = trace_ac108_set_clock_enabled() ? ktime_get_ns() : 0;
+	int sysclk_en = ac ? ac->sysclk_en : 0;
+	int ret;
+
+	ret = __ac108_set_clock(y_start_n_stop, substream, cmd, dai);
+	trace_ac108_set_clock(y_start_n_stop, sysclk_en, ac ? ac->sysclk_en : 0, ret,
+			      t0 ? ktime_get_ns() - t0 : 0);
+	return ret;
+}
+
+/*
+ * mic offset calibration of the analog mics, at codec probe and again at
+ * resume after the chip lost power. The chip compensates with the result
+ * itself, MICn_OFFSET_STATU are read only status. The stream clocks aren't
+ * set up then, so SYSCLK runs from MCLK for the calibration only, the
+ * "mclk" clock enabled for it if the node has one.
+ * Tried once: skipped or timed out, it's marked done all the same, so
+ * resume doesn't pay for it again until the next power loss.
+ */
+#define MIC_OFFSET_CAL_TIMEOUT	50	/* ms */
+
+static int ac108_offset_calibrate(struct ac10x_priv *ac10x) {
+	int i, m, t, ret = 0;
+	u8 sysclk, clk_en, rst, msb, lsb;
+
+	ac10x->offset_cal = 1;
+
+	/* PDM mics have no analog offset, in slave mode MCLK may not run yet */
+	if (ac10x->dmic_en || !ac10x->i2s_master || ac10x->sysclk_en)
+		return 0;
+
+	if ((ret = clk_prepare_enable(ac10x->mclk_clk)) < 0) {
+		dev_err(&ac10x->i2c[_MASTER_INDEX]->dev, "MCLK enable failed: %d\n", ret);
+		return ret;
+	}
+
+	ac10x_read(SYSCLK_CTRL, &sysclk, ac10x->i2cmap[_MASTER_INDEX]);
+	ac10x_read(MOD_CLK_EN, &clk_en, ac10x->i2cmap[_MASTER_INDEX]);
+	ac10x_read(MOD_RST_CTRL, &rst, ac10x->i2cmap[_MASTER_INDEX]);
+
+	/*0x20: SYSCLK from MCLK, 0x21-0x22: calibration and ADC analog module clock on, out of reset*/
+	ac108_multi_update_bits(SYSCLK_CTRL, 0x01 << SYSCLK_SRC | 0x01 << SYSCLK_EN,
+				SYSCLK_SRC_MCLK << SYSCLK_SRC | 0x01 << SYSCLK_EN, ac10x);
+	ac108_multi_update_bits(MOD_CLK_EN, 0x01 << MIC_OFFSET_CALIBRATION | 0x01 << ADC_ANALOG,
+				0x01 << MIC_OFFSET_CALIBRATION | 0x01 << ADC_ANALOG, ac10x);
+	ac108_multi_update_bits(MOD_RST_CTRL, 0x01 << MIC_OFFSET_CALIBRATION | 0x01 << ADC_ANALOG,
+				0x01 << MIC_OFFSET_CALIBRATION | 0x01 << ADC_ANALOG, ac10x);
+
+	/*0x96: calibration of MIC1-4, 0x97: start once*/
+	ac108_multi_write(MIC_OFFSET_CTRL1, 0x0F, ac10x);
+	ac108_multi_update_bits(MIC_OFFSET_CTRL2, 0x01 << MIC_OFFSET_CAL_EN_ONCE,
+				0x01 << MIC_OFFSET_CAL_EN_ONCE, ac10x);
+
+	for (i = 0; i < ac10x->codec_cnt; i++) {
+		for (m = 0; m < 4; m++) {
+			/*0x98-0x9F: MICn_OFFSET_STATU1/2*/
+			for (t = 0; t < MIC_OFFSET_CAL_TIMEOUT; t++) {
+				ac10x_read(MIC1_OFFSET_STATU1 + m * 2, &msb, ac10x->i2cmap[i]);
+				if (msb & (0x01 << MIC1_OFFSET_CAL_DONE))
+					break;
+				msleep(1);
+			}
+			if (t >= MIC_OFFSET_CAL_TIMEOUT) {
+				dev_err(&ac10x->i2c[i]->dev, "MIC%d offset calibration timeout\n", m + 1);
+				ret = -ETIMEDOUT;
+				goto __ret;
+			}
+			ac10x_read(MIC1_OFFSET_STATU2 + m * 2, &lsb, ac10x->i2cmap[i]);
+			dev_dbg(&ac10x->i2c[i]->dev, "MIC%d offset 0x%04x\n", m + 1, (msb & 0x3F) << 8 | lsb);
+		}
+	}
+
+__ret:
+	ac108_multi_update_bits(MIC_OFFSET_CTRL2, 0x01 << MIC_OFFSET_CAL_EN_ONCE,
+				0x00 << MIC_OFFSET_CAL_EN_ONCE, ac10x);
+	ac108_multi_write(MOD_RST_CTRL, rst, ac10x);
+	ac108_multi_write(MOD_CLK_EN, clk_en, ac10x);
+	ac108_multi_write(SYSCLK_CTRL, sysclk, ac10x);
+	clk_disable_unprepare(ac10x->mclk_clk);
+	return ret;
+}
+
 int ac108_prepare(struct snd_pcm_substream *substream,
 					struct snd_soc_dai *dai)
 {
@@ -995,7 +1984,7 @@ int ac108_prepare(struct snd_pcm_substream *substream,
 	return 0;
 }
 
-int ac108_trigger(struct snd_pcm_substream *substream, int cmd,
+static int __ac108_trigger(struct snd_pcm_substream *substream, int cmd,
 			     struct snd_soc_dai *dai)
 {
 	struct snd_soc_codec *codec = dai->codec;
@@ -1013,6 +2002,9 @@ int ac108_trigger(struct snd_pcm_substream *substream, int cmd,
 	case SNDRV_PCM_TRIGGER_START:
 	case SNDRV_PCM_TRIGGER_RESUME:
 	case SNDRV_PCM_TRIGGER_PAUSE_RELEASE:
+		if (!ac10x->i2s_master) {
+			break;
+		}
 		spin_lock_irqsave(&ac10x->lock, flags);
 		/* disable global clock if lrck disabled */
 		ac10x_read(I2S_CTRL, &r, ac10x->i2cmap[_MASTER_INDEX]);
@@ -1039,12 +2031,46 @@ int ac108_trigger(struct snd_pcm_substream *substream, int cmd,
 	return ret;
 }
 
+int ac108_trigger(struct snd_pcm_substream *substream, int cmd,
+			     struct snd_soc_dai *dai)
+{
+	struct ac10x_priv *ac10x = dev_get_drvdata(dai->dev);
+	u64 t0 = trace_ac108_trigger_enabled() ? ktime_get_ns() : 0;
+	int ret;
+
+	ret = __ac108_trigger(substream, cmd, dai);
+	trace_ac108_trigger(ac10x->chip_index, substream->stream, cmd, ret, t0 ? ktime_get_ns() - t0 : 0);
+	return ret;
+}
+
 int ac108_audio_startup(struct snd_pcm_substream *substream,
 	struct snd_soc_dai *dai
 ) {
 	struct snd_soc_codec *codec = dai->codec;
 	struct ac10x_priv *ac10x = snd_soc_codec_get_drvdata(codec);
+	int ret;
+
+	ret = ac108_duplex_constraints(ac10x, substream);
+	if (ret < 0)
+		return ret;
+
+	/* only the mixed channels of each chip are on the bus, hw_params takes no other count */
+	if (ac10x->dmix_channels < 4) {
+		ret = snd_pcm_hw_constraint_minmax(substream->runtime, SNDRV_PCM_HW_PARAM_CHANNELS,
+						   ac10x->dmix_channels * ac108_array_chips(),
+						   ac10x->dmix_channels * ac108_array_chips());
+		if (ret < 0)
+			return ret;
+	}
 
+	if (!ac10x->runtime_pm)
+		return 0;
+
+	ret = pm_runtime_get_sync(&ac10x->i2c[_MASTER_INDEX]->dev);
+	if (ret < 0) {
+		pm_runtime_put_noidle(&ac10x->i2c[_MASTER_INDEX]->dev);
+		return ret;
+	}
 	return 0;
 }
 
@@ -1054,12 +2080,25 @@ void ac108_aif_shutdown(struct snd_pcm_substream *substream,
 	struct snd_soc_codec *codec = dai->codec;
 	struct ac10x_priv *ac10x = snd_soc_codec_get_drvdata(codec);
 
-	if (substream->stream == SNDRV_PCM_STREAM_CAPTURE) {
+	ac10x->plan[substream->stream].rate = 0;
+
+	if (!ac10x->i2s_master && !ac10x->plan[SNDRV_PCM_STREAM_PLAYBACK].rate
+	 && !ac10x->plan[SNDRV_PCM_STREAM_CAPTURE].rate) {
+		ac108_slave_clock(ac10x, 0);
+	}
+
+	/* playback still runs on the I2S of the chips */
+	if (substream->stream == SNDRV_PCM_STREAM_CAPTURE && !ac10x->plan[SNDRV_PCM_STREAM_PLAYBACK].rate) {
 		/*0x21: Module clock disable <I2S, ADC digital, MIC offset Calibration, ADC analog>*/
 		ac108_multi_write(MOD_CLK_EN, 0x0, ac10x);
 		/*0x22: Module reset asserted <I2S, ADC digital, MIC offset Calibration, ADC analog>*/
 		ac108_multi_write(MOD_RST_CTRL, 0x0, ac10x);
 	}
+
+	if (ac10x->runtime_pm) {
+		pm_runtime_mark_last_busy(&ac10x->i2c[_MASTER_INDEX]->dev);
+		pm_runtime_put_autosuspend(&ac10x->i2c[_MASTER_INDEX]->dev);
+	}
 }
 
 int ac108_aif_mute(struct snd_soc_dai *dai, int mute, int direction) {
@@ -1069,6 +2108,25 @@ int ac108_aif_mute(struct snd_soc_dai *dai, int mute, int direction) {
 	return 0;	
 }
 
+/* a sample waits in the TX FIFO for its slot of the next frame */
+#define AC108_TX_FIFO_FRAMES	1
+
+/*
+ * codec pipeline in frames of the stream, on top of the cpu_dai & DMA delay:
+ * decimation filter group delay of the profile in use at the ADC rate,
+ * from the per-rate table of the board DT, and the TX FIFO, both in frames
+ * of the ADC rate; with data-protocol 1 (encoding) the stream runs at
+ * twice the ADC rate. Follows profile changes at once.
+ */
+static snd_pcm_sframes_t ac108_delay(struct snd_pcm_substream *substream,
+				     struct snd_soc_dai *dai) {
+	struct ac10x_priv *ac10x = snd_soc_codec_get_drvdata(dai->codec);
+
+	if (substream->stream != SNDRV_PCM_STREAM_CAPTURE)
+		return 0;
+	return (ac108_group_delay(ac10x) + AC108_TX_FIFO_FRAMES) * (ac10x->data_protocol + 1UL);
+}
+
 static const struct snd_soc_dai_ops ac108_dai_ops = {
 	.startup	= ac108_audio_startup,
 	.shutdown	= ac108_aif_shutdown,
@@ -1081,6 +2139,7 @@ static const struct snd_soc_dai_ops ac108_dai_ops = {
 	.prepare	= ac108_prepare,
 	.trigger	= ac108_trigger,
 	.mute_stream	= ac108_aif_mute,
+	.delay		= ac108_delay,
 
 	/*DAI format configuration*/
 	.set_fmt	= ac108_set_fmt,
@@ -1089,48 +2148,91 @@ static const struct snd_soc_dai_ops ac108_dai_ops = {
 	.no_capture_mute = 1,
 };
 
-static  struct snd_soc_dai_driver ac108_dai0 = {
-	.name = "ac10x-codec0",
-	#if _USE_CAPTURE
-	.playback = {
-		.stream_name = "Playback",
-		.channels_min = 1,
-		.channels_max = AC108_CHANNELS_MAX,
-		.rates = AC108_RATES,
-		.formats = AC108_FORMATS,
+#if _USE_CAPTURE
+#define AC108_DAI_PLAYBACK \
+	.playback = { \
+		.stream_name = "Playback", \
+		.channels_min = 1, \
+		.channels_max = AC108_CHANNELS_MAX, \
+		.rates = AC108_RATES, \
+		.formats = AC108_FORMATS, \
 	},
-	#endif
-	.capture = {
-		.stream_name = "Capture",
-		.channels_min = 1,
-		.channels_max = AC108_CHANNELS_MAX,
-		.rates = AC108_RATES,
-		.formats = AC108_FORMATS,
-	},
-	.ops = &ac108_dai_ops,
+#else
+#define AC108_DAI_PLAYBACK
+#endif
+
+#define AC108_DAI(n) { \
+	.name = "ac10x-codec" #n, \
+	AC108_DAI_PLAYBACK \
+	.capture = { \
+		.stream_name = "Capture", \
+		.channels_min = 1, \
+		.channels_max = AC108_CHANNELS_MAX, \
+		.rates = AC108_RATES, \
+		.formats = AC108_FORMATS, \
+	}, \
+	.ops = &ac108_dai_ops, \
+}
+
+/* [i2c index], dai of each chip registered as its own component */
+static struct snd_soc_dai_driver ac108_dai[] = {
+	AC108_DAI(0),
+	AC108_DAI(1),
+	AC108_DAI(2),
+	AC108_DAI(3),
 };
 
 int ac108_add_widgets(struct snd_soc_codec *codec) {
-	//struct ac10x_priv *ac10x = snd_soc_codec_get_drvdata(codec);
+	struct ac10x_priv *ac10x = snd_soc_codec_get_drvdata(codec);
 	struct snd_soc_dapm_context *dapm = snd_soc_codec_get_dapm(codec);
 	const struct snd_kcontrol_new* snd_kcntl = ac108_snd_controls;
 	int ctrl_cnt = ARRAY_SIZE(ac108_snd_controls);
 
 	snd_soc_add_codec_controls(codec, snd_kcntl, ctrl_cnt);
+	if (ac10x->codec_cnt > 1) {
+		snd_soc_add_codec_controls(codec, ac108_snd_controls_chip1, ARRAY_SIZE(ac108_snd_controls_chip1));
+	}
 
 	snd_soc_dapm_new_controls(dapm, ac108_dapm_widgets,ARRAY_SIZE(ac108_dapm_widgets));
-	snd_soc_dapm_add_routes(dapm, ac108_dapm_routes, ARRAY_SIZE(ac108_dapm_routes));
+	if (ac10x->dmic_en) {
+		snd_soc_dapm_add_routes(dapm, ac108_dapm_dmic_routes, ARRAY_SIZE(ac108_dapm_dmic_routes));
+	} else {
+		snd_soc_dapm_add_routes(dapm, ac108_dapm_routes, ARRAY_SIZE(ac108_dapm_routes));
+	}
 
 	return 0;
 }
 
 int ac108_codec_probe(struct snd_soc_codec *codec) {
-	spin_lock_init(&ac10x->lock);
+	struct ac10x_priv *ac = ac10x;
+	int i;
 
-	ac10x->codec = codec;
-	dev_set_drvdata(codec->dev, ac10x);
+	/* a per chip component, its own controls, DAPM and regmap */
+	for (i = 0; i < ARRAY_SIZE(ac10x->chip); i++) {
+		if (ac10x->chip[i] && &ac10x->chip[i]->i2c[0]->dev == codec->dev)
+			ac = ac10x->chip[i];
+	}
+
+	spin_lock_init(&ac->lock);
+
+	ac->codec = codec;
+	dev_set_drvdata(codec->dev, ac);
 	ac108_add_widgets(codec);
 
+	/* autosuspended since the i2c probe, the calibration needs the chips */
+	if (ac->runtime_pm)
+		pm_runtime_get_sync(&ac->i2c[_MASTER_INDEX]->dev);
+	if (!ac->offset_cal)
+		ac108_offset_calibrate(ac);
+	if (ac->runtime_pm) {
+		pm_runtime_mark_last_busy(&ac->i2c[_MASTER_INDEX]->dev);
+		pm_runtime_put_autosuspend(&ac->i2c[_MASTER_INDEX]->dev);
+	}
+
+	if (ac->chip_index != _MASTER_INDEX)
+		return 0;
+	/* the master chip stands for the array, set_clock() and the DAC */
+	ac10x->codec = codec;
 	pcm5102a_codec_probe(codec);
 
 	return 0;
@@ -1178,31 +2280,121 @@ void ac108_codec_remove_void(struct snd_soc_codec *codec) {
 #define ac108_codec_remove ac108_codec_remove_void
 #endif
 
-int ac108_codec_suspend(struct snd_soc_codec *codec) {
-	struct ac10x_priv *ac10x = snd_soc_codec_get_drvdata(codec);
+/* registers not written back on resume */
+static bool ac108_no_sync_reg(unsigned int reg) {
+	/*0x00: writing resets the chip, 0x98-0x9F: volatile*/
+	return reg == CHIP_RST || (reg >= MIC1_OFFSET_STATU1 && reg <= MIC4_OFFSET_STATU2);
+}
+
+/* remember the hardware state, the cache holds it while not suspended */
+static void ac108_pm_snapshot(struct ac10x_priv *ac10x) {
+	int i, r;
+	unsigned v;
+
+	for (i = 0; i < ac10x->codec_cnt; i++) {
+		for (r = 0; r < AC108_REG_NUM; r++) {
+			if (ac108_no_sync_reg(r))
+				continue;
+			regmap_read(ac10x->i2cmap[i], r, &v);
+			ac10x->reg_hw[i][r] = v;
+		}
+	}
+}
+
+static void ac108_pm_cache_only(struct ac10x_priv *ac10x) {
 	int i;
 
 	for (i = 0; i < ac10x->codec_cnt; i++) {
 		regcache_cache_only(ac10x->i2cmap[i], true);
 	}
-
-	return 0;
+	ac10x->cache_only = 1;
 }
 
-int ac108_codec_resume(struct snd_soc_codec *codec) {
-	struct ac10x_priv *ac10x = snd_soc_codec_get_drvdata(codec);
-	int i, ret;
+/*
+ * Write back only registers the cache has changed against the hardware,
+ * contiguous runs as one bulk write, in register order which is also
+ * the power up order (LDO, VREF, PLL, then the analog front-end).
+ * If the chip lost power, the hardware is at reset defaults instead.
+ */
+static int ac108_pm_sync(struct ac10x_priv *ac10x, struct device *dev) {
+	u8 cache[AC108_REG_NUM];
+	const u8 *hw;
+	ktime_t t0 = ktime_get();
+	int i, r, start, ret = 0, writes = 0;
+	unsigned v;
 
-	/* Sync reg_cache with the hardware */
 	for (i = 0; i < ac10x->codec_cnt; i++) {
 		regcache_cache_only(ac10x->i2cmap[i], false);
-		ret = regcache_sync(ac10x->i2cmap[i]);
-		if (ret != 0) {
-			dev_err(codec->dev, "Failed to sync i2cmap%d register cache: %d\n", i, ret);
-			regcache_cache_only(ac10x->i2cmap[i], true);
+
+		hw = ac10x->reg_hw[i];
+		for (r = 0; r < AC108_REG_NUM; r++) {
+			if (ac108_no_sync_reg(r) || ac10x->reg_hw[i][r] == ac10x->reg_defaults[i][r])
+				continue;
+			/* a register known to differ from reset, back at reset means power lost */
+			regcache_cache_bypass(ac10x->i2cmap[i], true);
+			regmap_read(ac10x->i2cmap[i], r, &v);
+			regcache_cache_bypass(ac10x->i2cmap[i], false);
+			if (v == ac10x->reg_defaults[i][r]) {
+				dev_dbg(dev, "chip %d lost power, sync against reset defaults\n", i);
+				hw = ac10x->reg_defaults[i];
+				ac10x->offset_cal = 0;
+			}
+			break;
+		}
+
+		for (r = 0; r < AC108_REG_NUM; r++) {
+			if (ac108_no_sync_reg(r))
+				continue;
+			regmap_read(ac10x->i2cmap[i], r, &v);
+			cache[r] = v;
+		}
+
+		for (r = 0; r < AC108_REG_NUM; r++) {
+			if (ac108_no_sync_reg(r) || cache[r] == hw[r])
+				continue;
+			for (start = r; r + 1 < AC108_REG_NUM; r++) {
+				if (ac108_no_sync_reg(r + 1) || cache[r + 1] == hw[r + 1])
+					break;
+			}
+			ret = ac10x_bulk_write(start, &cache[start], r - start + 1, ac10x->i2cmap[i]);
+			if (ret < 0) {
+				dev_err(dev, "Failed to sync i2cmap%d 0x%02x-0x%02x: %d\n", i, start, r, ret);
+			}
+			writes++;
 		}
 	}
+	ac10x->cache_only = 0;
+
+	ac10x->resume_sync_us = ktime_us_delta(ktime_get(), t0);
+	dev_dbg(dev, "resume sync %d writes %uus\n", writes, ac10x->resume_sync_us);
+	return ret;
+}
+
+int ac108_codec_suspend(struct snd_soc_codec *codec) {
+	struct ac10x_priv *ac10x = snd_soc_codec_get_drvdata(codec);
+
+	/* already runtime suspended */
+	if (ac10x->cache_only)
+		return 0;
+
+	ac108_pm_snapshot(ac10x);
+	ac108_pm_cache_only(ac10x);
+	return 0;
+}
+
+int ac108_codec_resume(struct snd_soc_codec *codec) {
+	struct ac10x_priv *ac10x = snd_soc_codec_get_drvdata(codec);
+
+	/* runtime suspended before, the next runtime resume syncs */
+	if (ac10x->runtime_pm && pm_runtime_status_suspended(&ac10x->i2c[_MASTER_INDEX]->dev))
+		return 0;
 
+	if (ac10x->cache_only)
+		ac108_pm_sync(ac10x, codec->dev);
+
+	/* the chip lost power, and the calibration with it */
+	if (!ac10x->offset_cal)
+		ac108_offset_calibrate(ac10x);
 	return 0;
 }
 
@@ -1215,7 +2407,7 @@ static struct snd_soc_codec_driver ac10x_soc_codec_driver = {
 	.read		= ac108_codec_read,
 	.write		= ac108_codec_write,
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(4,17,0)
-	.idle_bias_on 	= 1,
+	.idle_bias_on 	= 0,
 	.use_pmdown_time 	= 1,
 	.endianness 	= 1,
 #endif
@@ -1292,17 +2484,106 @@ static struct attribute_group ac108_debug_attr_group = {
 	.attrs  = ac108_debug_attrs,
 };
 
+static bool ac108_volatile_reg(struct device *dev, unsigned int reg) {
+	/*0x98-0x9F: MIC1-4_OFFSET_STATU1/2, calibration results*/
+	return reg >= MIC1_OFFSET_STATU1 && reg <= MIC4_OFFSET_STATU2;
+}
+
+/*
+ * runtime PM, enable bits of the analog front-end, PLL and references,
+ * in power down order.
+ */
+static const struct {
+	u8 reg;
+	u8 mask;
+} ac108_pm_regs[] = {
+	{ ANA_ADC1_CTRL1, 0x01 << ADC1_DSM_ENABLE | 0x01 << ADC1_PGA_ENABLE | 0x01 << ADC1_MICBIAS_EN },
+	{ ANA_ADC2_CTRL1, 0x01 << ADC2_DSM_ENABLE | 0x01 << ADC2_PGA_ENABLE | 0x01 << ADC2_MICBIAS_EN },
+	{ ANA_ADC3_CTRL1, 0x01 << ADC3_DSM_ENABLE | 0x01 << ADC3_PGA_ENABLE | 0x01 << ADC3_MICBIAS_EN },
+	{ ANA_ADC4_CTRL1, 0x01 << ADC4_DSM_ENABLE | 0x01 << ADC4_PGA_ENABLE | 0x01 << ADC4_MICBIAS_EN },
+	{ PLL_CTRL1, 0x01 << PLL_EN | 0x01 << PLL_COM_EN },
+	{ PWR_CTRL9, 0x01 << VREFP_ENABLE },
+	{ PWR_CTRL7, 0x01 << VREF_ENABLE },
+	{ PWR_CTRL6, 0x01 << LDO33ANA_ENABLE },
+};
+
+/*
+ * runtime PM of dev covers the chip of its own component, or all of them
+ * on the master chip; NULL for a chip of the array, without runtime PM.
+ */
+static struct ac10x_priv *ac108_pm_priv(struct device *dev) {
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(ac10x->chip); i++) {
+		if (ac10x->chip[i] && &ac10x->chip[i]->i2c[0]->dev == dev)
+			return ac10x->chip[i];
+	}
+	if (ac10x->runtime_pm && &ac10x->i2c[_MASTER_INDEX]->dev == dev)
+		return ac10x;
+	return NULL;
+}
+
+/*
+ * The chips keep their registers, only the enable bits are cleared,
+ * bypassing the cache, so the cache still holds the running state.
+ */
+static int ac108_runtime_suspend(struct device *dev) {
+	struct ac10x_priv *ac10x = ac108_pm_priv(dev);
+	int i, r;
+	u8 reg;
+
+	if (!ac10x)
+		return -EBUSY;
+	dev_dbg(dev, "%s()\n", __func__);
+
+	ac108_pm_snapshot(ac10x);
+	for (i = 0; i < ac10x->codec_cnt; i++) {
+		for (r = 0; r < ARRAY_SIZE(ac108_pm_regs); r++) {
+			reg = ac108_pm_regs[r].reg;
+			ac10x->reg_hw[i][reg] &= ~ac108_pm_regs[r].mask;
+			regcache_cache_bypass(ac10x->i2cmap[i], true);
+			regmap_write(ac10x->i2cmap[i], reg, ac10x->reg_hw[i][reg]);
+			regcache_cache_bypass(ac10x->i2cmap[i], false);
+		}
+	}
+	ac108_pm_cache_only(ac10x);
+	return 0;
+}
+
+/* the enable bits differ from the snapshot, so the sync powers up too */
+static int ac108_runtime_resume(struct device *dev) {
+	struct ac10x_priv *ac10x = ac108_pm_priv(dev);
+
+	if (!ac10x)
+		return 0;
+	ac10x->resume_ts = ktime_get();
+
+	if (ac10x->cache_only)
+		ac108_pm_sync(ac10x, dev);
+	if (!ac10x->offset_cal)
+		ac108_offset_calibrate(ac10x);
+
+	dev_dbg(dev, "%s() %lldus\n", __func__, ktime_us_delta(ktime_get(), ac10x->resume_ts));
+	return 0;
+}
+
+static const struct dev_pm_ops ac108_pm_ops = {
+	SET_RUNTIME_PM_OPS(ac108_runtime_suspend, ac108_runtime_resume, NULL)
+};
+
 static const struct regmap_config ac108_regmap = {
 	.reg_bits = 8,
 	.val_bits = 8,
 	.reg_stride = 1,
 	.max_register = 0xDF,
+	.volatile_reg = ac108_volatile_reg,
 	.cache_type = REGCACHE_FLAT,
 };
 int ac108_i2c_probe(struct i2c_client *i2c, const struct i2c_device_id *i2c_id) {
 	struct device_node *np = i2c->dev.of_node;
 	unsigned int val = 0;
-	int ret = 0, index;
+	u32 dmix[4], dt[AC108_DEC_PROFILES * AC108_RATES];
+	int ret = 0, index, n;
 
 	if (ac10x == NULL) {
 		ac10x = kzalloc(sizeof(struct ac10x_priv), GFP_KERNEL);
@@ -1310,6 +2591,14 @@ int ac108_i2c_probe(struct i2c_client *i2c, const struct i2c_device_id *i2c_id)
 			dev_err(&i2c->dev, "Unable to allocate ac10x private data\n");
 			return -ENOMEM;
 		}
+
+		ac10x->hpf_cutoff = 10;
+		for (val = 0; val < ARRAY_SIZE(ac10x->dmix_src); val++) {
+			ac10x->dmix_src[val] = 1 << val;
+		}
+		ac10x->dmix_channels = 4;
+		ac10x->i2s_master = 1;
+		ac10x->dec_profiles = 1;
 	}
 
 	index = (int)i2c_id->driver_data;
@@ -1323,6 +2612,82 @@ int ac108_i2c_probe(struct i2c_client *i2c, const struct i2c_device_id *i2c_id)
 	if (of_property_read_u32(np, "tdm-chips-count", &val)) val = 1;
 	ac10x->tdm_chips_cnt = val;
 
+	/*
+	 * The following are the same for all chips,
+	 * set on any of them, default 10Hz HPF, no mixing.
+	 */
+	/* HPF cutoff in Hz, 0 - off */
+	if (!of_property_read_u32(np, "hpf-cutoff-hz", &val))
+		ac10x->hpf_cutoff = min_t(unsigned, val, AC108_HPF_CUTOFF_MAX);
+
+	/* digital mixer preset, ADC1-4_DMIX_SRC */
+	if (!of_property_read_u32_array(np, "adc-dmix-src", dmix, ARRAY_SIZE(dmix))) {
+		for (val = 0; val < ARRAY_SIZE(dmix); val++) {
+			ac10x->dmix_src[val] = dmix[val] & 0xFF;
+		}
+	}
+	/* mixed channels of each chip carried by TDM, the others are dropped */
+	if (!of_property_read_u32(np, "adc-dmix-channels", &val))
+		ac10x->dmix_channels = clamp_t(unsigned, val, 1, 4);
+
+	/*
+	 * PDM mics, DMIC_EN bits: 1 - DMIC1 (2 mics), 3 - DMIC1 & DMIC2 (4 mics),
+	 * with DMIC1 only, 2 channels of each chip are carried by TDM.
+	 */
+	if (!of_property_read_u32(np, "dmic-enable", &val)) {
+		ac10x->dmic_en = val & (0x01 << DMIC1_EN | 0x01 << DMIC2_EN);
+		if (ac10x->dmic_en == (0x01 << DMIC1_EN) && ac10x->dmix_channels > 2)
+			ac10x->dmix_channels = 2;
+	}
+	/*
+	 * decimation filter profiles after the reset default,
+	 * adc-filter-profiles: <ADC_DSR ADC_FIR> of each;
+	 * adc-group-delay-frames: AC108_RATES delays of each profile, the
+	 * reset default first, at the rates of ac108_sample_rate[];
+	 * adc-filter-profile: the one in use from probe.
+	 */
+	n = of_property_count_u32_elems(np, "adc-filter-profiles") / 2;
+	if (n > 0) {
+		n = min(n, AC108_DEC_PROFILES - 1);
+		if (!of_property_read_u32_array(np, "adc-filter-profiles", dt, n * 2)) {
+			for (val = 0; val < n; val++) {
+				ac10x->dec_profile[val + 1].dsr = dt[val * 2] & 0xFF;
+				ac10x->dec_profile[val + 1].fir = dt[val * 2 + 1] & 0xFF;
+			}
+			ac10x->dec_profiles = n + 1;
+		}
+	}
+	n = of_property_count_u32_elems(np, "adc-group-delay-frames");
+	if (n > 0) {
+		n = min(n, ac10x->dec_profiles * AC108_RATES);
+		if (!of_property_read_u32_array(np, "adc-group-delay-frames", dt, n)) {
+			for (val = 0; val < n; val++) {
+				ac10x->dec_profile[val / AC108_RATES].delay[val % AC108_RATES] = min_t(u32, dt[val], U16_MAX);
+			}
+		}
+	}
+	if (!of_property_read_u32(np, "adc-filter-profile", &val) && val < ac10x->dec_profiles)
+		ac10x->dec_sel = val;
+
+	/* optional MCLK, without one it's taken as free running, a board oscillator */
+	if (!ac10x->mclk_clk) {
+		ac10x->mclk_clk = devm_clk_get_optional(&i2c->dev, "mclk");
+		if (IS_ERR(ac10x->mclk_clk)) {
+			ret = PTR_ERR(ac10x->mclk_clk);
+			ac10x->mclk_clk = NULL;
+			if (ret == -EPROBE_DEFER)
+				return ret;
+			dev_warn(&i2c->dev, "mclk: %d, taken as free running\n", ret);
+		}
+	}
+
+	/* optional GPIO_CFG1/2 values, for boards routing DMIC over GPIO pins */
+	if (!of_property_read_u32_array(np, "dmic-gpio-cfg", dmix, 2)) {
+		ac10x->gpio_cfg[0] = dmix[0] & 0xFF;
+		ac10x->gpio_cfg[1] = dmix[1] & 0xFF;
+		ac10x->dmic_gpio_cfg = 1;
+	}
+
 	pr_info(" ac10x i2c_id number: %d\n", index);
 	pr_info(" ac10x data protocol: %d\n", ac10x->data_protocol);
 
@@ -1344,22 +2709,106 @@ int ac108_i2c_probe(struct i2c_client *i2c, const struct i2c_device_id *i2c_id)
 
 	/* sync regcache for FLAT type */
 	ac10x_fill_regcache(&i2c->dev, ac10x->i2cmap[index]);
+	for (val = 0; val < AC108_REG_NUM; val++) {
+		unsigned v = 0;
+
+		if (!ac108_no_sync_reg(val))
+			regmap_read(ac10x->i2cmap[index], val, &v);
+		ac10x->reg_defaults[index][val] = v;
+	}
+	ac10x->dec_profile[0].dsr = ac10x->reg_defaults[index][ADC_DSR];
+	ac10x->dec_profile[0].fir = ac10x->reg_defaults[index][ADC_FIR];
 
 	ac10x->codec_cnt++;
 	pr_info(" ac10x codec count  : %d\n", ac10x->codec_cnt);
 
+	/*
+	 * one component for each chip, dai "ac10x-codec<index>", bound by a
+	 * multi-codec dai-link; the DT properties of its node are its own.
+	 */
+	if (of_property_read_bool(np, "component-per-chip")) {
+		struct ac10x_priv *chip;
+
+		chip = kmemdup(ac10x, sizeof(*ac10x), GFP_KERNEL);
+		if (chip == NULL) {
+			return -ENOMEM;
+		}
+		memset(chip->i2c, 0, sizeof(chip->i2c));
+		memset(chip->i2cmap, 0, sizeof(chip->i2cmap));
+		memset(chip->chip, 0, sizeof(chip->chip));
+		chip->i2c[0] = i2c;
+		chip->i2cmap[0] = ac10x->i2cmap[index];
+		chip->codec_cnt = 1;
+		chip->chip_index = index;
+		chip->codec = NULL;
+		chip->runtime_pm = 0;
+		memcpy(chip->reg_defaults[0], ac10x->reg_defaults[index], sizeof(chip->reg_defaults[0]));
+		ac10x->chip[index] = chip;
+
+		ret = snd_soc_register_codec(&i2c->dev, &ac10x_soc_codec_driver, &ac108_dai[index], 1);
+		if (ret < 0) {
+			dev_err(&i2c->dev, "Failed to register codec%d: %d\n", index, ret);
+			ac10x->chip[index] = NULL;
+			kfree(chip);
+			return ret;
+		}
+	}
+
 	ret = sysfs_create_group(&i2c->dev.kobj, &ac108_debug_attr_group);
 	if (ret) {
 		pr_err("failed to create attr group\n");
 	}
 
+	/*
+	 * runtime PM on the master chip, covering all chips, or on each chip
+	 * of its own component, suspended apart from the others;
+	 * autosuspend delay from DT, or power/autosuspend_delay_ms.
+	 */
+	if (index == _MASTER_INDEX || ac10x->chip[index]) {
+		if (of_property_read_u32(np, "autosuspend-delay-ms", &val)) val = 3000;
+		pm_runtime_set_autosuspend_delay(&i2c->dev, val);
+		pm_runtime_use_autosuspend(&i2c->dev);
+		if (ac10x->chip[index]) {
+			ac10x->chip[index]->runtime_pm = 1;
+		} else {
+			ac10x->runtime_pm = 1;
+		}
+		pm_runtime_set_active(&i2c->dev);
+		pm_runtime_enable(&i2c->dev);
+		/* powered down after the delay, until the first stream */
+		pm_runtime_mark_last_busy(&i2c->dev);
+		pm_request_autosuspend(&i2c->dev);
+	}
+
 	/* It's time to bind codec to i2c[_MASTER_INDEX] when all i2c are ready */
 	seeed_voice_card_register_set_clock(SNDRV_PCM_STREAM_CAPTURE, ac108_set_clock);
 	return ret;
 }
 
 static void ac108_i2c_remove(struct i2c_client *i2c) {
-	if (ac10x->codec != NULL) {
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(ac10x->chip); i++) {
+		if (!ac10x->chip[i] || ac10x->chip[i]->i2c[0] != i2c)
+			continue;
+		snd_soc_unregister_codec(&i2c->dev);
+		if (ac10x->chip[i]->runtime_pm) {
+			pm_runtime_disable(&i2c->dev);
+			pm_runtime_dont_use_autosuspend(&i2c->dev);
+		}
+		kfree(ac10x->chip[i]);
+		ac10x->chip[i] = NULL;
+		if (i == _MASTER_INDEX)
+			ac10x->codec = NULL;
+	}
+
+	if (i2c == ac10x->i2c[_MASTER_INDEX] && ac10x->runtime_pm) {
+		pm_runtime_disable(&i2c->dev);
+		pm_runtime_dont_use_autosuspend(&i2c->dev);
+		ac10x->runtime_pm = 0;
+	}
+
+	if (ac10x->codec != NULL && !ac10x->chip[_MASTER_INDEX]) {
 		snd_soc_unregister_codec(&ac10x->i2c[_MASTER_INDEX]->dev);
 		ac10x->codec = NULL;
 	}
@@ -1376,12 +2825,18 @@ static void ac108_i2c_remove(struct i2c_client *i2c) {
 
 static const struct i2c_device_id ac108_i2c_id[] = {
 	{ "ac108_0", 0 },
+	{ "ac108_1", 1 },
+	{ "ac108_2", 2 },
+	{ "ac108_3", 3 },
 	{ }
 };
 MODULE_DEVICE_TABLE(i2c, ac108_i2c_id);
 
 static const struct of_device_id ac108_of_match[] = {
 	{ .compatible = "x-power,ac108_0", },
+	{ .compatible = "x-power,ac108_1", },
+	{ .compatible = "x-power,ac108_2", },
+	{ .compatible = "x-power,ac108_3", },
 	{ }
 };
 MODULE_DEVICE_TABLE(of, ac108_of_match);
@@ -1390,6 +2845,7 @@ static struct i2c_driver ac108_i2c_driver = {
 	.driver = {
 		.name = "ac10x-codec",
 		.of_match_table = ac108_of_match,
+		.pm = &ac108_pm_ops,
 	},
 	.probe =    ac108_i2c_probe,
 	.remove =   ac108_i2c_remove,
@@ -0,0 +1,365 @@
+/*
+ * ac108_agc - closed loop gain control of the ac108 mic array
+ *
+ * Reads the capture stream, measures the level of each channel and
+ * drives the codec gain instead of scaling samples in software,
+ * analog PGA first (0..31dB, 1dB steps) and the digital volume
+ * (0.75dB steps) for the fine part and for anything out of PGA range.
+ *
+ * All channels of all chips go out in one control write each,
+ * "Array PGA gain" and "Array digital volume" of the ac108 driver,
+ * which the driver applies as one bulk i2c write per chip.
+ *
+ * Every gain change is logged as one line,
+ *   <CLOCK_MONOTONIC s.ns> <frame> <channel> <pga> <dvol> <total gain dB>
+ * frame is the index in the capture stream of the first frame
+ * captured with the new gain, from snd_pcm_delay() taken right before
+ * the control write, the time the stream timestamp of that position.
+ * The codec group delay isn't documented and isn't included. Frames
+ * lost to an xrun are counted, so the index stays the stream time.
+ * Downstream DSP can undo the gain with it.
+ *
+ * Best run on a front-end or the shared device of the voice card,
+ * e.g. ac108_agc -D hw:seeed8micvoicec,3 -C hw:seeed8micvoicec
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <math.h>
+#include <alsa/asoundlib.h>
+
+#define AGC_MAX_CHANNELS	16
+
+#define PGA_MAX			31	/* dB */
+#define DVOL_0DB		0x9F	/* -119.25dB + 0.75dB * 0x9F */
+#define DVOL_MAX		0xFF
+
+static const char *pcm_name = "hw:seeed8micvoicec,3";
+static const char *ctl_name = "hw:seeed8micvoicec";
+static unsigned rate = 48000;
+static unsigned channels = 8;
+static unsigned period = 480;
+static double target = -26.0;		/* dBFS, rms */
+static double hysteresis = 3.0;		/* dB, no change inside +-hysteresis */
+static double max_step = 3.0;		/* dB per change */
+static double gate = -70.0;		/* dBFS, don't raise gain below this */
+static double gain_min = -20.0;		/* dB, total */
+static double gain_max = 50.0;		/* dB, total */
+static unsigned hold_ms = 500;		/* after a change, time to settle */
+static FILE *log_file;
+
+static volatile sig_atomic_t quit;
+
+struct agc_chan {
+	double level;		/* smoothed rms, dBFS */
+	double gain;		/* requested total gain, dB */
+	int pga;
+	int dvol;
+	unsigned long long hold_until;	/* frame */
+};
+
+static struct agc_chan chan[AGC_MAX_CHANNELS];
+
+static void on_signal(int sig)
+{
+	quit = 1;
+}
+
+static void usage(const char *prog)
+{
+	printf("Usage: %s [options]\n"
+	       "  -D pcm        capture device (%s)\n"
+	       "  -C ctl        control device of the card (%s)\n"
+	       "  -r rate       capture rate (%u)\n"
+	       "  -c channels   capture channels, ordered as the array controls (%u)\n"
+	       "  -p frames     measure period (%u)\n"
+	       "  -t dBFS       target rms level (%.1f)\n"
+	       "  -H dB         hysteresis (%.1f)\n"
+	       "  -s dB         max step per change (%.1f)\n"
+	       "  -g dBFS       noise gate (%.1f)\n"
+	       "  -m ms         hold time after a change (%u)\n"
+	       "  -l file       gain change log (stdout)\n",
+	       prog, pcm_name, ctl_name, rate, channels, period,
+	       target, hysteresis, max_step, gate, hold_ms);
+}
+
+static int ctl_find(snd_ctl_t *ctl, const char *name, snd_ctl_elem_value_t *val, unsigned *count)
+{
+	snd_ctl_elem_id_t *id;
+	snd_ctl_elem_info_t *info;
+	int r;
+
+	snd_ctl_elem_id_alloca(&id);
+	snd_ctl_elem_info_alloca(&info);
+
+	snd_ctl_elem_id_set_interface(id, SND_CTL_ELEM_IFACE_MIXER);
+	snd_ctl_elem_id_set_name(id, name);
+	snd_ctl_elem_info_set_id(info, id);
+	if ((r = snd_ctl_elem_info(ctl, info)) < 0) {
+		fprintf(stderr, "control '%s': %s\n", name, snd_strerror(r));
+		return r;
+	}
+	/* resolved numid, writes skip the name lookup */
+	snd_ctl_elem_info_get_id(info, id);
+	snd_ctl_elem_value_set_id(val, id);
+	*count = snd_ctl_elem_info_get_count(info);
+
+	return snd_ctl_elem_read(ctl, val);
+}
+
+static void split_gain(struct agc_chan *c)
+{
+	int pga, dvol;
+
+	pga = (int)lrint(c->gain);
+	if (pga < 0)
+		pga = 0;
+	if (pga > PGA_MAX)
+		pga = PGA_MAX;
+	dvol = DVOL_0DB + (int)lrint((c->gain - pga) / 0.75);
+	if (dvol < 0)
+		dvol = 0;
+	if (dvol > DVOL_MAX)
+		dvol = DVOL_MAX;
+
+	c->pga = pga;
+	c->dvol = dvol;
+}
+
+static double total_gain(const struct agc_chan *c)
+{
+	return c->pga + (c->dvol - DVOL_0DB) * 0.75;
+}
+
+/*
+ * recover from an xrun and count the frames lost to it, the ones left
+ * in the buffer and the ones not captured until the restart
+ */
+static int recover(snd_pcm_t *pcm, int err, unsigned long long *frame)
+{
+	snd_pcm_status_t *status;
+	snd_htimestamp_t stop, start;
+	snd_pcm_uframes_t dropped;
+	long long ns;
+	int r;
+
+	snd_pcm_status_alloca(&status);
+	if ((r = snd_pcm_status(pcm, status)) < 0)
+		return r;
+	dropped = snd_pcm_status_get_avail(status);
+	snd_pcm_status_get_trigger_htstamp(status, &stop);
+
+	if ((r = snd_pcm_recover(pcm, err, 0)) < 0)
+		return r;
+	/* started here, not by the next read, for the restart time */
+	if ((r = snd_pcm_start(pcm)) < 0 ||
+	    (r = snd_pcm_status(pcm, status)) < 0)
+		return r;
+	snd_pcm_status_get_trigger_htstamp(status, &start);
+
+	ns = (start.tv_sec - stop.tv_sec) * 1000000000LL + start.tv_nsec - stop.tv_nsec;
+	if (ns < 0)
+		ns = 0;
+	*frame += dropped + (unsigned long long)ns * rate / 1000000000ULL;
+	return 0;
+}
+
+static void measure(const int32_t *buf, snd_pcm_uframes_t frames)
+{
+	static const double full = 2147483648.0;
+	double sum[AGC_MAX_CHANNELS] = { 0 };
+	snd_pcm_uframes_t f;
+	unsigned i;
+
+	for (f = 0; f < frames; f++) {
+		for (i = 0; i < channels; i++) {
+			double s = buf[f * channels + i] / full;
+
+			sum[i] += s * s;
+		}
+	}
+
+	for (i = 0; i < channels; i++) {
+		double db = 10.0 * log10(sum[i] / frames + 1e-20);
+		/* fast attack, slow release */
+		double k = db > chan[i].level ? 0.5 : 0.05;
+
+		chan[i].level += k * (db - chan[i].level);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	snd_pcm_t *pcm;
+	snd_ctl_t *ctl;
+	snd_pcm_sw_params_t *sw;
+	snd_ctl_elem_value_t *pga_val, *dvol_val;
+	unsigned pga_cnt, dvol_cnt, i;
+	unsigned long long frame = 0;
+	int32_t *buf;
+	int opt, r;
+
+	log_file = stdout;
+	while ((opt = getopt(argc, argv, "D:C:r:c:p:t:H:s:g:m:l:h")) != -1) {
+		switch (opt) {
+		case 'D': pcm_name = optarg; break;
+		case 'C': ctl_name = optarg; break;
+		case 'r': rate = atoi(optarg); break;
+		case 'c': channels = atoi(optarg); break;
+		case 'p': period = atoi(optarg); break;
+		case 't': target = atof(optarg); break;
+		case 'H': hysteresis = atof(optarg); break;
+		case 's': max_step = atof(optarg); break;
+		case 'g': gate = atof(optarg); break;
+		case 'm': hold_ms = atoi(optarg); break;
+		case 'l':
+			if (!(log_file = fopen(optarg, "a"))) {
+				perror(optarg);
+				return 1;
+			}
+			break;
+		default:
+			usage(argv[0]);
+			return opt != 'h';
+		}
+	}
+	if (channels == 0 || channels > AGC_MAX_CHANNELS || period == 0) {
+		usage(argv[0]);
+		return 1;
+	}
+	setvbuf(log_file, NULL, _IOLBF, 0);
+
+	if ((r = snd_ctl_open(&ctl, ctl_name, 0)) < 0) {
+		fprintf(stderr, "%s: %s\n", ctl_name, snd_strerror(r));
+		return 1;
+	}
+	snd_ctl_elem_value_alloca(&pga_val);
+	snd_ctl_elem_value_alloca(&dvol_val);
+	if (ctl_find(ctl, "Array PGA gain", pga_val, &pga_cnt) < 0 ||
+	    ctl_find(ctl, "Array digital volume", dvol_val, &dvol_cnt) < 0)
+		return 1;
+	if (pga_cnt < channels || dvol_cnt < channels) {
+		fprintf(stderr, "%u channels, controls have %u\n", channels, pga_cnt);
+		return 1;
+	}
+
+	/* start from the current gains */
+	for (i = 0; i < channels; i++) {
+		chan[i].pga = snd_ctl_elem_value_get_integer(pga_val, i);
+		chan[i].dvol = snd_ctl_elem_value_get_integer(dvol_val, i);
+		chan[i].gain = total_gain(&chan[i]);
+		chan[i].level = target;
+	}
+
+	if ((r = snd_pcm_open(&pcm, pcm_name, SND_PCM_STREAM_CAPTURE, 0)) < 0) {
+		fprintf(stderr, "%s: %s\n", pcm_name, snd_strerror(r));
+		return 1;
+	}
+	if ((r = snd_pcm_set_params(pcm, SND_PCM_FORMAT_S32_LE, SND_PCM_ACCESS_RW_INTERLEAVED,
+				    channels, rate, 0, 4 * 1000000ULL * period / rate)) < 0) {
+		fprintf(stderr, "%s: %s\n", pcm_name, snd_strerror(r));
+		return 1;
+	}
+	/* stream position timestamps, on the clock of the log */
+	snd_pcm_sw_params_alloca(&sw);
+	if ((r = snd_pcm_sw_params_current(pcm, sw)) < 0 ||
+	    (r = snd_pcm_sw_params_set_tstamp_mode(pcm, sw, SND_PCM_TSTAMP_ENABLE)) < 0 ||
+	    (r = snd_pcm_sw_params_set_tstamp_type(pcm, sw, SND_PCM_TSTAMP_TYPE_MONOTONIC)) < 0 ||
+	    (r = snd_pcm_sw_params(pcm, sw)) < 0) {
+		fprintf(stderr, "%s: %s\n", pcm_name, snd_strerror(r));
+		return 1;
+	}
+	buf = malloc(period * channels * sizeof(*buf));
+	if (!buf)
+		return 1;
+
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+
+	while (!quit) {
+		snd_pcm_sframes_t n, delay;
+		snd_pcm_uframes_t avail;
+		snd_htimestamp_t ts;
+		int changed[AGC_MAX_CHANNELS] = { 0 };
+		int pga_dirty = 0, dvol_dirty = 0;
+
+		n = snd_pcm_readi(pcm, buf, period);
+		if (n < 0) {
+			if (recover(pcm, n, &frame) < 0)
+				break;
+			continue;
+		}
+		measure(buf, n);
+		frame += n;
+
+		for (i = 0; i < channels; i++) {
+			struct agc_chan *c = &chan[i];
+			double err = target - c->level;
+			int pga = c->pga, dvol = c->dvol;
+			double old = total_gain(c);
+
+			if (frame < c->hold_until || fabs(err) <= hysteresis)
+				continue;
+			if (err > 0 && c->level < gate)
+				continue;
+
+			if (err > max_step)
+				err = max_step;
+			if (err < -max_step)
+				err = -max_step;
+			c->gain += err;
+			if (c->gain < gain_min)
+				c->gain = gain_min;
+			if (c->gain > gain_max)
+				c->gain = gain_max;
+
+			split_gain(c);
+			if (c->pga == pga && c->dvol == dvol)
+				continue;
+
+			/* the level jumps with the gain, no need to wait for the filter */
+			c->level += total_gain(c) - old;
+			c->hold_until = frame + (unsigned long long)hold_ms * rate / 1000;
+
+			snd_ctl_elem_value_set_integer(pga_val, i, c->pga);
+			snd_ctl_elem_value_set_integer(dvol_val, i, c->dvol);
+			pga_dirty |= c->pga != pga;
+			dvol_dirty |= c->dvol != dvol;
+			changed[i] = 1;
+		}
+		if (!pga_dirty && !dvol_dirty)
+			continue;
+
+		/*
+		 * frames captured with the old gain, still unread or in flight,
+		 * before the write so the time of the write isn't counted in
+		 */
+		if (snd_pcm_delay(pcm, &delay) < 0 || delay < 0)
+			delay = 0;
+		if (snd_pcm_htimestamp(pcm, &avail, &ts) < 0)
+			clock_gettime(CLOCK_MONOTONIC, &ts);
+
+		if (pga_dirty && (r = snd_ctl_elem_write(ctl, pga_val)) < 0)
+			fprintf(stderr, "Array PGA gain: %s\n", snd_strerror(r));
+		if (dvol_dirty && (r = snd_ctl_elem_write(ctl, dvol_val)) < 0)
+			fprintf(stderr, "Array digital volume: %s\n", snd_strerror(r));
+
+		for (i = 0; i < channels; i++) {
+			if (!changed[i])
+				continue;
+			fprintf(log_file, "%ld.%09ld %llu %u %d %d %.2f\n",
+				(long)ts.tv_sec, ts.tv_nsec, frame + delay, i,
+				chan[i].pga, chan[i].dvol, total_gain(&chan[i]));
+		}
+	}
+
+	free(buf);
+	snd_pcm_close(pcm);
+	snd_ctl_close(ctl);
+	if (log_file != stdout)
+		fclose(log_file);
+	return 0;
+}
@@ -372,8 +372,20 @@ static int ac108_sw_params(snd_pcm_ioplug_t *io, snd_pcm_sw_params_t *params) {
 	return 0;
 }
 #endif 
+/*
+ * delay of the slave, DMA, cpu_dai FIFO and the codec pipeline reported
+ * by the driver, in slave frames of twice the rate, not read yet by us,
+ * plus our buffered frames not read yet by the application; the slave
+ * frames readable by us are in our hw_ptr already
+ */
 static int ac108_delay(snd_pcm_ioplug_t * io, snd_pcm_sframes_t * delayp){
+	struct ac108_t *capture = io->private_data;
+	snd_pcm_sframes_t avail, delay;
+	int err;
 
+	if ((err = snd_pcm_avail_delay(capture->pcm, &avail, &delay)) < 0)
+		return err;
+	*delayp = (delay - avail) / 2 + snd_pcm_ioplug_avail(io, io->hw_ptr, io->appl_ptr);
 	return 0;
 }
 /*
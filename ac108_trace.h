@@ -0,0 +1,216 @@
+/*
+ * ac108_trace.h  --  tracepoints of the ac108 codec driver
+ *
+ * durations in ns, measured only while the event is enabled:
+ *   perf record -e 'ac108:*' / echo 1 > /sys/kernel/tracing/events/ac108/enable
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM ac108
+
+#if !defined(__AC108_TRACE_H__) || defined(TRACE_HEADER_MULTI_READ)
+#define __AC108_TRACE_H__
+
+#include <linux/tracepoint.h>
+#include <linux/regmap.h>
+#include <linux/version.h>
+
+/* the source is taken from __string() since 6.10 */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6,10,0)
+#define ac108_assign_str(dst, src)	__assign_str(dst)
+#else
+#define ac108_assign_str(dst, src)	__assign_str(dst, src)
+#endif
+
+/* one register access of one chip, ac10x_write() / ac10x_update_bits() */
+DECLARE_EVENT_CLASS(ac108_reg,
+	TP_PROTO(struct regmap *map, u8 reg, u8 mask, u8 val, int ret, u64 ns),
+	TP_ARGS(map, reg, mask, val, ret, ns),
+
+	TP_STRUCT__entry(
+		__string(dev, dev_name(regmap_get_device(map)))
+		__field(u8, reg)
+		__field(u8, mask)
+		__field(u8, val)
+		__field(int, ret)
+		__field(u64, ns)
+	),
+
+	TP_fast_assign(
+		ac108_assign_str(dev, dev_name(regmap_get_device(map)));
+		__entry->reg = reg;
+		__entry->mask = mask;
+		__entry->val = val;
+		__entry->ret = ret;
+		__entry->ns = ns;
+	),
+
+	TP_printk("%s reg=0x%02x mask=0x%02x val=0x%02x ret=%d ns=%llu",
+		  __get_str(dev), __entry->reg, __entry->mask, __entry->val,
+		  __entry->ret, __entry->ns)
+);
+
+DEFINE_EVENT(ac108_reg, ac108_reg_write,
+	TP_PROTO(struct regmap *map, u8 reg, u8 mask, u8 val, int ret, u64 ns),
+	TP_ARGS(map, reg, mask, val, ret, ns)
+);
+
+DEFINE_EVENT(ac108_reg, ac108_reg_update,
+	TP_PROTO(struct regmap *map, u8 reg, u8 mask, u8 val, int ret, u64 ns),
+	TP_ARGS(map, reg, mask, val, ret, ns)
+);
+
+/* a run of registers of one chip, reg: the first one, count: registers written */
+DECLARE_EVENT_CLASS(ac108_reg_run,
+	TP_PROTO(struct regmap *map, u8 reg, int count, int ret, u64 ns),
+	TP_ARGS(map, reg, count, ret, ns),
+
+	TP_STRUCT__entry(
+		__string(dev, dev_name(regmap_get_device(map)))
+		__field(u8, reg)
+		__field(int, count)
+		__field(int, ret)
+		__field(u64, ns)
+	),
+
+	TP_fast_assign(
+		ac108_assign_str(dev, dev_name(regmap_get_device(map)));
+		__entry->reg = reg;
+		__entry->count = count;
+		__entry->ret = ret;
+		__entry->ns = ns;
+	),
+
+	TP_printk("%s reg=0x%02x count=%d ret=%d ns=%llu",
+		  __get_str(dev), __entry->reg, __entry->count,
+		  __entry->ret, __entry->ns)
+);
+
+/* contiguous registers, gang gain controls and the PM resume sync */
+DEFINE_EVENT(ac108_reg_run, ac108_reg_bulk_write,
+	TP_PROTO(struct regmap *map, u8 reg, int count, int ret, u64 ns),
+	TP_ARGS(map, reg, count, ret, ns)
+);
+
+/* a DAPM power sequence, registers in sequence order, reg is the first */
+DEFINE_EVENT(ac108_reg_run, ac108_reg_multi_write,
+	TP_PROTO(struct regmap *map, u8 reg, int count, int ret, u64 ns),
+	TP_ARGS(map, reg, count, ret, ns)
+);
+
+TRACE_EVENT(ac108_hw_params,
+	TP_PROTO(int chip, int stream, unsigned rate, unsigned channels,
+		 int format, int ret, u64 ns),
+	TP_ARGS(chip, stream, rate, channels, format, ret, ns),
+
+	TP_STRUCT__entry(
+		__field(int, chip)
+		__field(int, stream)
+		__field(unsigned, rate)
+		__field(unsigned, channels)
+		__field(int, format)
+		__field(int, ret)
+		__field(u64, ns)
+	),
+
+	TP_fast_assign(
+		__entry->chip = chip;
+		__entry->stream = stream;
+		__entry->rate = rate;
+		__entry->channels = channels;
+		__entry->format = format;
+		__entry->ret = ret;
+		__entry->ns = ns;
+	),
+
+	TP_printk("chip=%d stream=%d rate=%u channels=%u format=%d ret=%d ns=%llu",
+		  __entry->chip, __entry->stream, __entry->rate, __entry->channels,
+		  __entry->format, __entry->ret, __entry->ns)
+);
+
+TRACE_EVENT(ac108_set_fmt,
+	TP_PROTO(int chip, unsigned fmt, int master, int ret, u64 ns),
+	TP_ARGS(chip, fmt, master, ret, ns),
+
+	TP_STRUCT__entry(
+		__field(int, chip)
+		__field(unsigned, fmt)
+		__field(int, master)
+		__field(int, ret)
+		__field(u64, ns)
+	),
+
+	TP_fast_assign(
+		__entry->chip = chip;
+		__entry->fmt = fmt;
+		__entry->master = master;
+		__entry->ret = ret;
+		__entry->ns = ns;
+	),
+
+	TP_printk("chip=%d fmt=0x%04x master=%d ret=%d ns=%llu",
+		  __entry->chip, __entry->fmt, __entry->master,
+		  __entry->ret, __entry->ns)
+);
+
+/* cmd: 0 - stop, 1 - start, 2 - AC10X_CLOCK_XRUN; sysclk_en before & after */
+TRACE_EVENT(ac108_set_clock,
+	TP_PROTO(int cmd, int sysclk_from, int sysclk_to, int ret, u64 ns),
+	TP_ARGS(cmd, sysclk_from, sysclk_to, ret, ns),
+
+	TP_STRUCT__entry(
+		__field(int, cmd)
+		__field(int, sysclk_from)
+		__field(int, sysclk_to)
+		__field(int, ret)
+		__field(u64, ns)
+	),
+
+	TP_fast_assign(
+		__entry->cmd = cmd;
+		__entry->sysclk_from = sysclk_from;
+		__entry->sysclk_to = sysclk_to;
+		__entry->ret = ret;
+		__entry->ns = ns;
+	),
+
+	TP_printk("cmd=%d sysclk_en=%d->%d ret=%d ns=%llu",
+		  __entry->cmd, __entry->sysclk_from, __entry->sysclk_to,
+		  __entry->ret, __entry->ns)
+);
+
+TRACE_EVENT(ac108_trigger,
+	TP_PROTO(int chip, int stream, int cmd, int ret, u64 ns),
+	TP_ARGS(chip, stream, cmd, ret, ns),
+
+	TP_STRUCT__entry(
+		__field(int, chip)
+		__field(int, stream)
+		__field(int, cmd)
+		__field(int, ret)
+		__field(u64, ns)
+	),
+
+	TP_fast_assign(
+		__entry->chip = chip;
+		__entry->stream = stream;
+		__entry->cmd = cmd;
+		__entry->ret = ret;
+		__entry->ns = ns;
+	),
+
+	TP_printk("chip=%d stream=%d cmd=%d ret=%d ns=%llu",
+		  __entry->chip, __entry->stream, __entry->cmd,
+		  __entry->ret, __entry->ns)
+);
+
+#endif /* __AC108_TRACE_H__ */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE ac108_trace
+#include <trace/define_trace.h>
@@ -54,18 +54,76 @@ struct ac10x_priv {
 	struct i2c_client *i2c[4];
 	struct regmap* i2cmap[4];
 	int codec_cnt;
+	/*
+	 * component-per-chip, each chip is a component of a multi-codec
+	 * dai-link, its priv has codec_cnt 1 and the chip as i2c[0].
+	 */
+	struct ac10x_priv *chip[4];	/* [i2c index], of the array */
+	int chip_index;		/* i2c index of i2c[0] */
 	unsigned sysclk;
 #define _FREQ_24_576K		24576000
 #define _FREQ_22_579K		22579200
 	unsigned mclk;	/* master clock or aif_clock/aclk */
+	struct clk *mclk_clk;	/* optional "mclk" of the node, NULL - free running */
 	int clk_id;
 	unsigned char i2s_mode;
 	unsigned char data_protocol;
 	// struct delayed_work dlywork;
 	int tdm_chips_cnt;
 	int sysclk_en;
+	int i2s_master;		/* 1 - chips drive BCLK/LRCK, 0 - the SoC does, PLL locks to BCLK */
 	int dac_enable;
 	spinlock_t lock;
+#define AC108_HPF_CUTOFF_MAX	1000
+	unsigned hpf_cutoff;	/* HPF cutoff in Hz, 0 - HPF off */
+	unsigned hpf_rate;	/* ADC rate of the HPF coefficients and group delay, 0 - not configured */
+
+	/* decimation filter profiles, [0] the reset default, the others from DT */
+#define AC108_DEC_PROFILES	4
+#define AC108_RATES		10	/* ac108_sample_rate[] */
+	struct ac108_dec_profile {
+		u8 dsr;			/* ADC_DSR of all chips */
+		u8 fir;			/* ADC_FIR of all chips */
+		u16 delay[AC108_RATES];	/* group delay in frames at each ADC rate, 0 - unknown */
+	} dec_profile[AC108_DEC_PROFILES];
+	int dec_profiles;	/* valid in dec_profile[], 1 at least */
+	int dec_sel;		/* profile in use */
+	u8 dmix_src[4];		/* ADC1-4_DMIX_SRC of all chips */
+	int dmix_channels;	/* digital channels of each chip carried by TDM, 1-4 */
+	int offset_cal;		/* 1 - mic offset calibration tried since the last power loss */
+	u8 dmic_en;		/* DMIC_EN, bit0 DMIC1 -> ADC1/2, bit1 DMIC2 -> ADC3/4, 0 - analog mics */
+	int dmic_gpio_cfg;	/* 1 - gpio_cfg[] valid */
+	u8 gpio_cfg[2];		/* GPIO_CFG1/2, pins of DMIC clock & data */
+
+	/* runtime PM on i2c[_MASTER_INDEX], of all chips or of a chip component */
+	int runtime_pm;
+	ktime_t resume_ts;	/* runtime resume time, 0 - measured */
+	unsigned resume_latency_us;	/* runtime resume to first frame */
+
+	/* resume sync, registers 0x00-0xDF of each chip */
+#define AC108_REG_NUM		0xE0
+	int cache_only;		/* 1 - regmaps in cache only mode */
+	u8 reg_defaults[4][AC108_REG_NUM];	/* after CHIP_RST */
+	u8 reg_hw[4][AC108_REG_NUM];	/* hardware state when suspended */
+	unsigned resume_sync_us;	/* time of the last resume sync */
+
+	/* DAPM writes batched between the PRE and POST widgets */
+#define AC108_DAPM_BATCH_MAX	64
+	int dapm_batch;		/* 1 - codec writes are queued */
+	int dapm_batch_cnt;
+	struct reg_sequence dapm_seq[AC108_DAPM_BATCH_MAX];
+	ktime_t dapm_ts;
+	unsigned dapm_us;	/* time of the last DAPM sequence */
+
+	/* bus plan of each configured direction, the other one follows it */
+	struct ac10x_plan {
+		unsigned rate;		/* 0 - direction not configured */
+		unsigned channels;
+		snd_pcm_format_t format;
+	} plan[2];		/* [SNDRV_PCM_STREAM_*] */
+
+	unsigned gain_apply_us;		/* ganged gain controls, last apply time */
+	unsigned gain_apply_max_us;	/* and the longest one */
 
 	/* member for DAC .begin */
 	struct snd_soc_codec *codec;
@@ -94,6 +152,8 @@ int ac10x_read(u8 reg, u8* rt_val, struct regmap* i2cm);
 int ac10x_write(u8 reg, u8 val, struct regmap* i2cm);
 int ac10x_update_bits(u8 reg, u8 mask, u8 val, struct regmap* i2cm);
 int ac108_config_pll(struct ac10x_priv *ac10x, unsigned rate, unsigned lrck_ratio);
+int ac108_duplex_check(struct ac10x_priv *ac10x, struct snd_pcm_substream *substream,
+		       struct snd_pcm_hw_params *params);
 int ac108_i2c_probe(struct i2c_client *i2c, const struct i2c_device_id *i2c_id);
 void ac108_configure_power(struct ac10x_priv *ac10x);
 
@@ -110,6 +170,16 @@ void pcm5102a_shutdown(struct i2c_client *i2c);
 int pcm5102a_remove(struct i2c_client *i2c);
 
 /* seeed voice card export */
+/*
+ * y_start_n_stop of set_clock(), 0 - stop, 1 - start,
+ * 2 - overrun, stop the frames only, PLL & BCLK keep running
+ * and the next start only brings LRCK back,
+ * 3 - query only, returns 0 stopped, 1 running, 2 overrun gated.
+ * dai is the codec dai of the calling card, always given, it selects
+ * the chips; a set_clock() ignores the dai of another codec.
+ */
+#define AC10X_CLOCK_XRUN	2
+#define AC10X_CLOCK_STATE	3
 int seeed_voice_card_register_set_clock(int stream, int (*set_clock)(int, struct snd_pcm_substream *, int, struct snd_soc_dai *));
 
 int ac10x_fill_regcache(struct device* dev, struct regmap* map);
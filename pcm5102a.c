@@ -169,7 +169,6 @@ int pcm5102a_hw_params(struct snd_pcm_substream *substream,
 	struct snd_soc_codec *codec = dai->codec;
 	struct ac10x_priv *ac10x = snd_soc_codec_get_drvdata(codec);
 	unsigned bclkdiv;
-	int current_bclkdiv;
 	int ret = 0;
 	u8 reg;
 	u8 v;
@@ -183,11 +182,17 @@ int pcm5102a_hw_params(struct snd_pcm_substream *substream,
 	// 	}
 	// }
 
-	if ((substream->stream == SNDRV_PCM_STREAM_CAPTURE && dai->stream_active[SNDRV_PCM_STREAM_PLAYBACK])
-	 || (substream->stream == SNDRV_PCM_STREAM_PLAYBACK && dai->stream_active[SNDRV_PCM_STREAM_CAPTURE])) {
+	if ((substream->stream == SNDRV_PCM_STREAM_CAPTURE && ac10x->plan[SNDRV_PCM_STREAM_PLAYBACK].rate)
+	 || (substream->stream == SNDRV_PCM_STREAM_PLAYBACK && ac10x->plan[SNDRV_PCM_STREAM_CAPTURE].rate)) {
 		/* If playback is performed after capture, it is need to reset only the LRCK appropriately. */
 		channels = params_channels(params);
 
+		/*the bus runs the plan of the other direction, hw rules kept the request on it, checked before any write*/
+		ret = ac108_duplex_check(ac10x, substream, params);
+		if (ret < 0) {
+			return ret;
+		}
+
 		switch (params_format(params)) {
 		case SNDRV_PCM_FORMAT_S8:
 			samp_res = 0;
@@ -258,25 +263,16 @@ int pcm5102a_hw_params(struct snd_pcm_substream *substream,
 			ac108_multi_update_bits(I2S_LRCK_CTRL1, 0x03 << 0, (div >> 8) << 0, ac10x);
 		}
 
-		/*read the register and if the settings are not matched to the request, reset the register*/
-		ac10x_read(I2S_BCLK_CTRL, &reg, ac10x->i2cmap[_MASTER_INDEX]);
-		current_bclkdiv = ac108_bclkdivs[(reg & 0x0f) ];
-
-		if (ac10x->mclk/current_bclkdiv/params_rate(params)/params_channels(params)/ac108_samp_res[samp_res].real_val != 1) {
-			return -EINVAL;
-		}
-		else{
-			div = ac108_samp_res[samp_res].real_val * channels - 1;
-			ac108_multi_write(I2S_LRCK_CTRL2, (div & 0xFF), ac10x);
-			ac108_multi_update_bits(I2S_LRCK_CTRL1, 0x03 << 0, (div >> 8) << 0, ac10x);
-		}
+		/* LRCK_IOEN is in I2S_CTRL */
+		ac10x_read(I2S_CTRL, &reg, ac10x->i2cmap[_MASTER_INDEX]);
 
 		if (reg & (0x01 << LRCK_IOEN)) {
-			ret = ret || ac10x_update_bits(I2S_CTRL, 0x03 << LRCK_IOEN, 0x01 << BCLK_IOEN, ac10x->i2cmap[_MASTER_INDEX]);
-		}
-		if (!ret) {
-			ac10x->sysclk_en = 0UL;
+			ret = ac10x_update_bits(I2S_CTRL, 0x03 << LRCK_IOEN, 0x01 << BCLK_IOEN, ac10x->i2cmap[_MASTER_INDEX]);
+			if (ret < 0) {
+				return ret;
+			}
 		}
+		ac10x->sysclk_en = 0UL;
 
 		return 0;
 	}
@@ -394,6 +390,10 @@ int pcm5102a_hw_params(struct snd_pcm_substream *substream,
 		}
 		ac108_multi_update_bits(I2S_BCLK_CTRL, 0x0F << BCLKDIV, i << BCLKDIV, ac10x);
 
+		ac10x->plan[substream->stream].rate = params_rate(params);
+		ac10x->plan[substream->stream].channels = channels;
+		ac10x->plan[substream->stream].format = params_format(params);
+
 		/*0x21: Module clock enable<I2S, ADC digital, MIC offset Calibration, ADC analog>*/
 		ac108_multi_write(MOD_CLK_EN, 1 << I2S | 1 << ADC_DIGITAL | 1 << MIC_OFFSET_CALIBRATION | 1 << ADC_ANALOG, ac10x);
 		/*0x22: Module reset de-asserted<I2S, ADC digital, MIC offset Calibration, ADC analog>*/
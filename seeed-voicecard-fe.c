@@ -0,0 +1,1401 @@
+/*
+ * SEEED voice card front-ends
+ *
+ * (C) Copyright 2017-2018
+ * Seeed Technology Co., Ltd. <www.seeedstudio.com>
+ *
+ * The bcm2835 I2S has a single capture DMA, so ASoC DPCM can't give every
+ * front-end its own DMA. Instead, the capture back-end (dai-link 0) is
+ * opened by the kernel and kept free running, and each front-end PCM device
+ * picks its channel subset, decimates to its rate and converts its format
+ * from the back-end DMA buffer once per back-end period.
+ *
+ * Optionally the playback of the same dai-link is appended to each back-end
+ * frame as AEC reference channels. Both directions run on one LRCK, so the
+ * reference is locked to the mics once per playback start and then follows
+ * them frame by frame, without drift. The lock reads the two DMA positions
+ * one after the other, it's as accurate as the DMA residue, not sample
+ * accurate; aec-reference-delay and the AEC itself take up the rest.
+ * The AC108 can't carry the reference in its own TX frame: its TX slot
+ * maps and digital mixer take ADC1-4 only, the I2S RX1 data goes to no
+ * TX slot, and I2S_LPB_DEBUG loops its TX output back to its RX, the
+ * other way round. The playback goes to the DAC, not to the AC108.
+ *
+ * A playback front-end takes a narrow stream (stereo) and writes it into
+ * the slots of the back-end playback, so applications don't have to feed
+ * every TDM slot through plug/dmix.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+/* #undef DEBUG */
+#include <linux/version.h>
+#include <linux/device.h>
+#include <linux/fs.h>
+#include <linux/hrtimer.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/of.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <sound/core.h>
+#include <sound/pcm.h>
+#include <sound/pcm_params.h>
+#include <sound/soc.h>
+#include "seeed-voicecard-fe.h"
+
+#define SEEED_FE_MAX		4
+#define SEEED_FE_CHANNELS_MAX	16
+#define SEEED_FE_READERS_MAX	8
+#define SEEED_FE_REF_MAX	4
+
+/*
+ * Decimation low-pass filters, Blackman windowed sinc,
+ * cutoff at 0.45 of the output rate, Q15.
+ * Only the first half (and the center tap) is stored, the filters are symmetric.
+ */
+/* 65 taps, 2 -> 1 */
+static const s16 seeed_fe_fir_2[33] = {
+	0, 0, -1, 0, 5, 4, -11, -14, 17, 35, -16, -69,
+	0, 113, 45, -160, -130, 192, 267, -182, -459, 91, 696, 131,
+	-959, -556, 1218, 1336, -1438, -2989, 1586, 10261, 14742,
+};
+
+/* 97 taps, 3 -> 1 */
+static const s16 seeed_fe_fir_3[49] = {
+	0, 0, 0, -1, -1, 1, 3, 4, 0, -8, -11, -5,
+	11, 24, 17, -11, -40, -41, 0, 57, 78, 30, -65, -128,
+	-87, 52, 184, 178, 0, -230, -306, -112, 241, 464, 308, -183,
+	-639, -619, 0, 812, 1107, 422, -959, -1996, -1490, 1058, 4925, 8424,
+	9832,
+};
+
+/* 129 taps, 4 -> 1 */
+static const s16 seeed_fe_fir_4[65] = {
+	0, 0, 0, 0, -1, -1, 0, 1, 3, 3, 2, -1,
+	-6, -8, -7, -1, 8, 16, 18, 9, -8, -26, -34, -26,
+	0, 33, 56, 55, 22, -31, -80, -97, -65, 10, 96, 149,
+	134, 42, -91, -203, -229, -138, 45, 241, 348, 290, 65, -240,
+	-480, -513, -278, 158, 609, 838, 668, 84, -719, -1380, -1495, -779,
+	793, 2938, 5131, 6767, 7378,
+};
+
+/* 193 taps, 6 -> 1 */
+static const s16 seeed_fe_fir_6[97] = {
+	0, 0, 0, 0, 0, 0, 0, -1, 0, 0, 0, 1,
+	2, 2, 2, 1, 0, -2, -4, -5, -6, -5, -2, 1,
+	6, 10, 12, 12, 9, 3, -5, -14, -20, -23, -20, -12,
+	0, 15, 28, 38, 39, 31, 15, -8, -33, -53, -64, -61,
+	-43, -12, 26, 64, 92, 102, 89, 53, 0, -61, -115, -149,
+	-153, -121, -56, 30, 121, 194, 232, 220, 154, 44, -92, -223,
+	-320, -354, -309, -185, 0, 212, 406, 533, 554, 445, 211, -116,
+	-479, -801, -998, -996, -745, -228, 529, 1459, 2463, 3420, 4212, 4733,
+	4906,
+};
+
+static const struct {
+	unsigned decimation;
+	const s16 *fir;
+	unsigned taps;
+} seeed_fe_firs[] = {
+	{ 2, seeed_fe_fir_2, 65 },
+	{ 3, seeed_fe_fir_3, 97 },
+	{ 4, seeed_fe_fir_4, 129 },
+	{ 6, seeed_fe_fir_6, 193 },
+};
+
+struct seeed_fe_card;
+
+struct seeed_fe {
+	struct seeed_fe_card *fec;
+	const char *name;
+	unsigned channels;
+	unsigned channel_map[SEEED_FE_CHANNELS_MAX];	/* back-end channel of each */
+	unsigned rate;
+	snd_pcm_format_t format;
+	unsigned decimation;
+	const s16 *fir;
+	unsigned taps;
+	s32 *hist;			/* channels * 2 * taps, doubled ring */
+	s32 *ref_buf;			/* reference frames of one tick, copied under fec->lock */
+	struct snd_pcm *pcm;
+
+	/*
+	 * runtime state, converted by the timer under fe->lock,
+	 * a softirq lock, the filters run with interrupts on
+	 */
+	spinlock_t lock;
+	struct snd_pcm_substream *substream;
+	int running;
+	snd_pcm_uframes_t be_ptr;	/* back-end hw_ptr consumed */
+	snd_pcm_uframes_t pos;		/* front-end buffer position */
+	snd_pcm_uframes_t period_frames;
+	unsigned phase;
+	unsigned hist_pos;
+	int ref;			/* 1 - channel_map has reference channels */
+	unsigned ref_gen;		/* lock of ref_ptr, see fec->ref_gen */
+	snd_pcm_uframes_t ref_ptr;	/* playback frame sent with be_ptr */
+};
+
+struct seeed_fe_card {
+	struct device *dev;
+	struct snd_soc_card *card;
+	int fe_cnt;
+	struct seeed_fe fe[SEEED_FE_MAX];
+
+	/* back-end configuration */
+	unsigned be_device;
+	unsigned be_rate;
+	unsigned be_channels;
+	unsigned be_period;
+	unsigned be_periods;
+
+	struct mutex be_mutex;		/* back-end open/close */
+	int be_users;
+	struct file be_file[2];		/* in-kernel open, only its f_flags are read */
+	struct snd_pcm_substream *be;
+	spinlock_t lock;
+	struct hrtimer timer;
+	ktime_t period_time;
+	struct snd_dma_buffer be_buf;	/* back-end DMA buffer, shared by readers */
+
+	/*
+	 * shared device, every substream reads the back-end DMA buffer in place,
+	 * only the application pointer is per reader.
+	 */
+	unsigned readers;		/* 0 - no shared device */
+	struct snd_pcm *shared_pcm;
+	struct snd_pcm_substream *reader[SEEED_FE_READERS_MAX];
+	int reader_running[SEEED_FE_READERS_MAX];
+
+	/*
+	 * AEC reference, channels be_channels.. of the front-end channel-map,
+	 * read from the playback DMA buffer of the back-end dai-link.
+	 */
+	unsigned ref_channels;		/* 0 - no reference */
+	unsigned ref_map[SEEED_FE_REF_MAX];	/* playback channel of each */
+	unsigned ref_delay;		/* frames between playback and capture DMA on the wire */
+	struct snd_pcm_substream *play;	/* running playback, NULL - none */
+	int ref_lock;			/* 1 - lock at the next tick */
+	unsigned ref_gen;		/* incremented by every lock */
+	snd_pcm_uframes_t ref_be;	/* back-end DMA position ... */
+	snd_pcm_uframes_t ref_play;	/* ... and the playback one, same instant */
+
+	/* playback front-end, replicated into the back-end playback slots */
+	unsigned pb_slots;		/* 0 - no playback front-end */
+	unsigned pb_map[SEEED_FE_CHANNELS_MAX];	/* front-end channel of each slot */
+	unsigned pb_channels;
+	struct snd_pcm *pb_pcm;
+	struct snd_pcm_substream *pb;	/* open front-end substream */
+	int pb_running;
+	snd_pcm_uframes_t pb_pos;	/* front-end buffer position */
+	snd_pcm_uframes_t pb_period_frames;
+	struct snd_pcm_substream *pb_be;
+	snd_pcm_uframes_t pb_be_appl;	/* written up to, back-end hw_ptr space */
+	struct hrtimer pb_timer;
+};
+
+static void seeed_fe_param_mask(struct snd_pcm_hw_params *params,
+				snd_pcm_hw_param_t var, unsigned int val)
+{
+	snd_mask_none(hw_param_mask(params, var));
+	snd_mask_set(hw_param_mask(params, var), val);
+	params->cmask |= 1 << var;
+	params->rmask |= 1 << var;
+}
+
+static void seeed_fe_param_int(struct snd_pcm_hw_params *params,
+			       snd_pcm_hw_param_t var, unsigned int val)
+{
+	struct snd_interval *i = hw_param_interval(params, var);
+
+	i->min = i->max = val;
+	i->openmin = i->openmax = 0;
+	i->integer = 1;
+	i->empty = 0;
+	params->cmask |= 1 << var;
+	params->rmask |= 1 << var;
+}
+
+/*
+ * Open a back-end substream in the kernel, as the OSS emulation does,
+ * no device node or mount namespace involved. It's busy while an
+ * application holds the back-end device.
+ */
+static int seeed_fe_be_open(struct seeed_fe_card *fec, int stream,
+			    struct snd_pcm_substream **psubstream)
+{
+	struct snd_soc_pcm_runtime *rtd;
+	struct snd_pcm *pcm = NULL;
+	struct file *file = &fec->be_file[stream];
+	int ret;
+
+	for_each_card_rtds(fec->card, rtd) {
+		if (rtd->pcm && rtd->pcm->device == fec->be_device)
+			pcm = rtd->pcm;
+	}
+	if (!pcm)
+		return -ENODEV;
+
+	file->f_flags = O_NONBLOCK |
+		(stream == SNDRV_PCM_STREAM_PLAYBACK ? O_WRONLY : O_RDONLY);
+	mutex_lock(&pcm->open_mutex);
+	ret = snd_pcm_open_substream(pcm, stream, file, psubstream);
+	mutex_unlock(&pcm->open_mutex);
+	if (ret == -EAGAIN)
+		ret = -EBUSY;
+	if (ret < 0)
+		dev_err(fec->dev, "can't open back-end %s%s: %d\n", snd_pcm_direction_name(stream),
+			ret == -EBUSY ? ", held by an application" : "", ret);
+	return ret;
+}
+
+static void seeed_fe_be_close(struct snd_pcm_substream *substream)
+{
+	struct snd_pcm *pcm = substream->pcm;
+
+	mutex_lock(&pcm->open_mutex);
+	snd_pcm_release_substream(substream);
+	mutex_unlock(&pcm->open_mutex);
+}
+
+/*
+ * Open the back-end like a normal reader would, and leave it free running:
+ * stop_threshold = boundary, the front-ends follow its hw_ptr.
+ */
+static int seeed_fe_be_start(struct seeed_fe_card *fec)
+{
+	struct snd_pcm_hw_params *params = NULL;
+	struct snd_pcm_sw_params *sw_params = NULL;
+	struct snd_pcm_substream *be;
+	int ret;
+
+	ret = seeed_fe_be_open(fec, SNDRV_PCM_STREAM_CAPTURE, &be);
+	if (ret < 0)
+		return ret;
+
+	params = kzalloc(sizeof(*params), GFP_KERNEL);
+	sw_params = kzalloc(sizeof(*sw_params), GFP_KERNEL);
+	if (!params || !sw_params) {
+		ret = -ENOMEM;
+		goto err;
+	}
+
+	_snd_pcm_hw_params_any(params);
+	seeed_fe_param_mask(params, SNDRV_PCM_HW_PARAM_ACCESS, SNDRV_PCM_ACCESS_MMAP_INTERLEAVED);
+	seeed_fe_param_mask(params, SNDRV_PCM_HW_PARAM_FORMAT, SNDRV_PCM_FORMAT_S32_LE);
+	seeed_fe_param_mask(params, SNDRV_PCM_HW_PARAM_SUBFORMAT, SNDRV_PCM_SUBFORMAT_STD);
+	seeed_fe_param_int(params, SNDRV_PCM_HW_PARAM_CHANNELS, fec->be_channels);
+	seeed_fe_param_int(params, SNDRV_PCM_HW_PARAM_RATE, fec->be_rate);
+	seeed_fe_param_int(params, SNDRV_PCM_HW_PARAM_PERIOD_SIZE, fec->be_period);
+	seeed_fe_param_int(params, SNDRV_PCM_HW_PARAM_PERIODS, fec->be_periods);
+
+	ret = snd_pcm_kernel_ioctl(be, SNDRV_PCM_IOCTL_HW_PARAMS, params);
+	if (ret < 0) {
+		dev_err(fec->dev, "back-end hw_params %uHz/%uch/%u error %d\n",
+			fec->be_rate, fec->be_channels, fec->be_period, ret);
+		goto err;
+	}
+
+	sw_params->tstamp_mode = SNDRV_PCM_TSTAMP_NONE;
+	sw_params->period_step = 1;
+	sw_params->avail_min = 1;
+	sw_params->start_threshold = 1;
+	sw_params->stop_threshold = be->runtime->boundary;
+	ret = snd_pcm_kernel_ioctl(be, SNDRV_PCM_IOCTL_SW_PARAMS, sw_params);
+	if (ret < 0)
+		goto err;
+
+	ret = snd_pcm_kernel_ioctl(be, SNDRV_PCM_IOCTL_PREPARE, NULL);
+	if (ret < 0)
+		goto err;
+
+	fec->be_buf.dev = be->dma_buffer.dev;
+	fec->be_buf.area = be->runtime->dma_area;
+	fec->be_buf.addr = be->runtime->dma_addr;
+	fec->be_buf.bytes = be->runtime->dma_bytes;
+
+	fec->be = be;
+
+	ret = snd_pcm_kernel_ioctl(be, SNDRV_PCM_IOCTL_START, NULL);
+	if (ret < 0) {
+		fec->be = NULL;
+		goto err;
+	}
+
+	hrtimer_start(&fec->timer, fec->period_time, HRTIMER_MODE_REL_SOFT);
+
+	kfree(sw_params);
+	kfree(params);
+	dev_dbg(fec->dev, "back-end capture started\n");
+	return 0;
+
+err:
+	kfree(sw_params);
+	kfree(params);
+	seeed_fe_be_close(be);
+	return ret;
+}
+
+static void seeed_fe_be_stop(struct seeed_fe_card *fec)
+{
+	struct snd_pcm_substream *be = fec->be;
+
+	hrtimer_cancel(&fec->timer);
+
+	snd_pcm_kernel_ioctl(be, SNDRV_PCM_IOCTL_DROP, NULL);
+	spin_lock_irq(&fec->lock);
+	fec->be = NULL;
+	spin_unlock_irq(&fec->lock);
+
+	seeed_fe_be_close(be);
+	dev_dbg(fec->dev, "back-end stopped\n");
+}
+
+static int seeed_fe_be_get(struct seeed_fe_card *fec)
+{
+	int ret = 0;
+
+	mutex_lock(&fec->be_mutex);
+	if (fec->be_users++ == 0) {
+		ret = seeed_fe_be_start(fec);
+		if (ret < 0)
+			fec->be_users--;
+	}
+	mutex_unlock(&fec->be_mutex);
+	return ret;
+}
+
+static void seeed_fe_be_put(struct seeed_fe_card *fec)
+{
+	mutex_lock(&fec->be_mutex);
+	if (--fec->be_users == 0)
+		seeed_fe_be_stop(fec);
+	mutex_unlock(&fec->be_mutex);
+}
+
+/*
+ * DMA position now, in the hw_ptr space of the stream,
+ * status->hw_ptr only moves once per period.
+ */
+snd_pcm_uframes_t seeed_voice_card_dma_pos(struct snd_pcm_substream *substream)
+{
+	struct snd_pcm_runtime *runtime = substream->runtime;
+	snd_pcm_uframes_t hw_ptr = READ_ONCE(runtime->status->hw_ptr);
+	snd_pcm_sframes_t d;
+
+	d = substream->ops->pointer(substream) - hw_ptr % runtime->buffer_size;
+	if (d < 0)
+		d += runtime->buffer_size;
+	hw_ptr += d;
+	if (hw_ptr >= runtime->boundary)
+		hw_ptr -= runtime->boundary;
+	return hw_ptr;
+}
+
+/* fill ref[] with the playback frame sent along with the back-end frame fe->be_ptr */
+static void seeed_fe_ref(struct seeed_fe *fe, snd_pcm_uframes_t be_boundary, s32 *ref)
+{
+	struct seeed_fe_card *fec = fe->fec;
+	struct snd_pcm_substream *play = fec->play;
+	struct snd_pcm_runtime *runtime;
+	snd_pcm_sframes_t d;
+	const u8 *src;
+	unsigned c;
+
+	memset(ref, 0, fec->ref_channels * sizeof(s32));
+	if (!play || !fec->ref_gen)
+		return;
+	runtime = play->runtime;
+
+	if (fe->ref_gen != fec->ref_gen) {
+		d = fec->ref_be - fe->be_ptr;
+		if (d < 0)
+			d += be_boundary;
+		d = (snd_pcm_sframes_t)fec->ref_play - d - (snd_pcm_sframes_t)fec->ref_delay;
+		while (d < 0)
+			d += runtime->boundary;
+		fe->ref_ptr = d;
+		fe->ref_gen = fec->ref_gen;
+	}
+
+	d = READ_ONCE(runtime->control->appl_ptr) - fe->ref_ptr;
+	if (d < 0)
+		d += runtime->boundary;
+	src = runtime->dma_area + frames_to_bytes(runtime, fe->ref_ptr % runtime->buffer_size);
+	if (++fe->ref_ptr >= runtime->boundary)
+		fe->ref_ptr = 0;
+
+	/* not queued by the application, or already overwritten */
+	if (d <= 0 || d > runtime->buffer_size)
+		return;
+
+	for (c = 0; c < fec->ref_channels; c++) {
+		switch (runtime->format) {
+		case SNDRV_PCM_FORMAT_S16_LE:
+			ref[c] = (s32)((const s16 *)src)[fec->ref_map[c]] << 16;
+			break;
+		case SNDRV_PCM_FORMAT_S24_LE:
+			ref[c] = ((const s32 *)src)[fec->ref_map[c]] << 8;
+			break;
+		case SNDRV_PCM_FORMAT_S32_LE:
+			ref[c] = ((const s32 *)src)[fec->ref_map[c]];
+			break;
+		default:
+			return;
+		}
+	}
+}
+
+/*
+ * push one back-end frame into the history of the front-end channels,
+ * the window oldest..newest is hist[hist_pos .. hist_pos + taps - 1]
+ */
+static void seeed_fe_push(struct seeed_fe *fe, const s32 *frame)
+{
+	unsigned c, n = fe->taps;
+
+	for (c = 0; c < fe->channels; c++) {
+		s32 *h = fe->hist + c * 2 * n;
+
+		h[fe->hist_pos] = h[fe->hist_pos + n] = frame[fe->channel_map[c]];
+	}
+	if (++fe->hist_pos >= n)
+		fe->hist_pos = 0;
+}
+
+static s32 seeed_fe_fir(const struct seeed_fe *fe, const s32 *h)
+{
+	unsigned k, n = fe->taps, c = n / 2;
+	s64 acc = (s64)fe->fir[c] * h[c];
+
+	for (k = 0; k < c; k++)
+		acc += (s64)fe->fir[k] * ((s64)h[k] + h[n - 1 - k]);
+
+	return clamp_t(s64, acc >> 15, S32_MIN, S32_MAX);
+}
+
+static void seeed_fe_put(struct seeed_fe *fe, struct snd_pcm_runtime *runtime,
+			 const s32 *frame)
+{
+	unsigned c;
+
+	if (fe->format == SNDRV_PCM_FORMAT_S16_LE) {
+		s16 *dst = (s16 *)runtime->dma_area + fe->pos * fe->channels;
+
+		for (c = 0; c < fe->channels; c++)
+			dst[c] = frame[c] >> 16;
+	} else {
+		s32 *dst = (s32 *)runtime->dma_area + fe->pos * fe->channels;
+
+		memcpy(dst, frame, fe->channels * sizeof(s32));
+	}
+
+	if (++fe->pos >= runtime->buffer_size)
+		fe->pos = 0;
+	fe->period_frames++;
+}
+
+/* back-end frames to convert up to hw_ptr */
+static snd_pcm_sframes_t seeed_fe_avail(struct seeed_fe *fe, struct snd_pcm_runtime *be_rt,
+					snd_pcm_uframes_t hw_ptr)
+{
+	snd_pcm_sframes_t avail;
+
+	avail = hw_ptr - fe->be_ptr;
+	if (avail < 0)
+		avail += be_rt->boundary;
+
+	/* the back-end overwrote what we didn't convert yet, skip to the newest */
+	if (avail > be_rt->buffer_size - be_rt->period_size) {
+		dev_dbg(fe->fec->dev, "%s: lost %ld frames\n", fe->name, avail);
+		avail = be_rt->period_size;
+		fe->be_ptr = hw_ptr - avail;
+		if ((snd_pcm_sframes_t)fe->be_ptr < 0)
+			fe->be_ptr += be_rt->boundary;
+	}
+	return avail;
+}
+
+/* reference of the next avail back-end frames into fe->ref_buf, under fec->lock */
+static void seeed_fe_ref_copy(struct seeed_fe *fe, snd_pcm_uframes_t be_boundary,
+			      snd_pcm_sframes_t avail)
+{
+	s32 *ref = fe->ref_buf;
+
+	while (avail-- > 0) {
+		seeed_fe_ref(fe, be_boundary, ref);
+		ref += fe->fec->ref_channels;
+	}
+}
+
+/*
+ * convert avail back-end frames from fe->be_ptr,
+ * return 1 if a front-end period elapsed.
+ */
+static int seeed_fe_update(struct seeed_fe *fe, struct snd_pcm_runtime *be_rt,
+			   snd_pcm_sframes_t avail)
+{
+	struct snd_pcm_runtime *runtime = fe->substream->runtime;
+	const s32 *ref = fe->ref_buf;
+	s32 out[SEEED_FE_CHANNELS_MAX];
+	s32 ext[SEEED_FE_CHANNELS_MAX + SEEED_FE_REF_MAX];
+	unsigned c;
+
+	while (avail-- > 0) {
+		const s32 *frame = (const s32 *)be_rt->dma_area +
+			(fe->be_ptr % be_rt->buffer_size) * be_rt->channels;
+
+		if (fe->ref) {
+			memcpy(ext, frame, be_rt->channels * sizeof(s32));
+			memcpy(ext + be_rt->channels, ref, fe->fec->ref_channels * sizeof(s32));
+			ref += fe->fec->ref_channels;
+			frame = ext;
+		}
+
+		if (++fe->be_ptr >= be_rt->boundary)
+			fe->be_ptr = 0;
+
+		if (!fe->fir) {
+			for (c = 0; c < fe->channels; c++)
+				out[c] = frame[fe->channel_map[c]];
+			seeed_fe_put(fe, runtime, out);
+			continue;
+		}
+
+		seeed_fe_push(fe, frame);
+		if (++fe->phase < fe->decimation)
+			continue;
+		fe->phase = 0;
+
+		for (c = 0; c < fe->channels; c++)
+			out[c] = seeed_fe_fir(fe, fe->hist + c * 2 * fe->taps + fe->hist_pos);
+		seeed_fe_put(fe, runtime, out);
+	}
+
+	if (fe->period_frames < runtime->period_size)
+		return 0;
+	fe->period_frames %= runtime->period_size;
+	return 1;
+}
+
+static enum hrtimer_restart seeed_fe_timer(struct hrtimer *timer)
+{
+	struct seeed_fe_card *fec = container_of(timer, struct seeed_fe_card, timer);
+	struct snd_pcm_runtime *be_rt;
+	snd_pcm_uframes_t hw_ptr;
+	snd_pcm_sframes_t avail;
+	unsigned long flags;
+	int i;
+
+	/*
+	 * fec->lock is held across snd_pcm_period_elapsed() of the readers,
+	 * front-end trigger() never takes it, close() does.
+	 */
+	spin_lock_irqsave(&fec->lock, flags);
+	if (!fec->be) {
+		spin_unlock_irqrestore(&fec->lock, flags);
+		return HRTIMER_NORESTART;
+	}
+
+	/* both DMAs are running by now, lock the reference to the back-end */
+	if (fec->play && fec->ref_lock) {
+		fec->ref_be = seeed_voice_card_dma_pos(fec->be);
+		fec->ref_play = seeed_voice_card_dma_pos(fec->play);
+		if (++fec->ref_gen == 0)
+			fec->ref_gen = 1;
+		fec->ref_lock = 0;
+	}
+
+	be_rt = fec->be->runtime;
+	hw_ptr = READ_ONCE(be_rt->status->hw_ptr);
+	for (i = 0; i < fec->readers; i++) {
+		if (fec->reader[i] && READ_ONCE(fec->reader_running[i]))
+			snd_pcm_period_elapsed(fec->reader[i]);
+	}
+	spin_unlock_irqrestore(&fec->lock, flags);
+
+	/*
+	 * The filters run under fe->lock only, interrupts on, the reference
+	 * is copied out under fec->lock first. fe->lock is held across
+	 * snd_pcm_period_elapsed() like above. be_rt stays valid, the
+	 * back-end stop cancels this timer first.
+	 */
+	for (i = 0; i < fec->fe_cnt; i++) {
+		struct seeed_fe *fe = &fec->fe[i];
+
+		spin_lock(&fe->lock);
+		if (fe->substream && READ_ONCE(fe->running)) {
+			avail = seeed_fe_avail(fe, be_rt, hw_ptr);
+			if (fe->ref) {
+				spin_lock_irqsave(&fec->lock, flags);
+				seeed_fe_ref_copy(fe, be_rt->boundary, avail);
+				spin_unlock_irqrestore(&fec->lock, flags);
+			}
+			if (seeed_fe_update(fe, be_rt, avail))
+				snd_pcm_period_elapsed(fe->substream);
+		}
+		spin_unlock(&fe->lock);
+	}
+
+	hrtimer_forward_now(timer, fec->period_time);
+	return HRTIMER_RESTART;
+}
+
+static const struct snd_pcm_hardware seeed_fe_hardware = {
+	.info			= SNDRV_PCM_INFO_MMAP |
+				  SNDRV_PCM_INFO_MMAP_VALID |
+				  SNDRV_PCM_INFO_INTERLEAVED |
+				  SNDRV_PCM_INFO_BLOCK_TRANSFER |
+				  SNDRV_PCM_INFO_PAUSE,
+	.buffer_bytes_max	= 128 * 1024,
+	.period_bytes_min	= 64,
+	.period_bytes_max	= 64 * 1024,
+	.periods_min		= 2,
+	.periods_max		= 1024,
+};
+
+static int seeed_fe_open(struct snd_pcm_substream *substream)
+{
+	struct seeed_fe *fe = snd_pcm_substream_chip(substream);
+	struct seeed_fe_card *fec = fe->fec;
+	struct snd_pcm_runtime *runtime = substream->runtime;
+	int ret;
+
+	runtime->hw = seeed_fe_hardware;
+	runtime->hw.formats = pcm_format_to_bits(fe->format);
+	runtime->hw.rates = snd_pcm_rate_to_rate_bit(fe->rate);
+	runtime->hw.rate_min = runtime->hw.rate_max = fe->rate;
+	runtime->hw.channels_min = runtime->hw.channels_max = fe->channels;
+
+	ret = seeed_fe_be_get(fec);
+	if (ret < 0)
+		return ret;
+
+	spin_lock_bh(&fe->lock);
+	fe->substream = substream;
+	fe->running = 0;
+	spin_unlock_bh(&fe->lock);
+	return 0;
+}
+
+static int seeed_fe_close(struct snd_pcm_substream *substream)
+{
+	struct seeed_fe *fe = snd_pcm_substream_chip(substream);
+	struct seeed_fe_card *fec = fe->fec;
+
+	spin_lock_bh(&fe->lock);
+	fe->running = 0;
+	fe->substream = NULL;
+	spin_unlock_bh(&fe->lock);
+
+	seeed_fe_be_put(fec);
+	return 0;
+}
+
+static int seeed_fe_prepare(struct snd_pcm_substream *substream)
+{
+	struct seeed_fe *fe = snd_pcm_substream_chip(substream);
+
+	spin_lock_bh(&fe->lock);
+	fe->pos = 0;
+	fe->period_frames = 0;
+	fe->phase = 0;
+	fe->hist_pos = 0;
+	if (fe->hist)
+		memset(fe->hist, 0, fe->channels * 2 * fe->taps * sizeof(s32));
+	spin_unlock_bh(&fe->lock);
+	return 0;
+}
+
+static int seeed_fe_trigger(struct snd_pcm_substream *substream, int cmd)
+{
+	struct seeed_fe *fe = snd_pcm_substream_chip(substream);
+	struct snd_pcm_substream *be = READ_ONCE(fe->fec->be);
+
+	switch (cmd) {
+	case SNDRV_PCM_TRIGGER_START:
+	case SNDRV_PCM_TRIGGER_RESUME:
+	case SNDRV_PCM_TRIGGER_PAUSE_RELEASE:
+		/* back-end gone, opened by the first front-end open */
+		if (!be || !be->runtime)
+			return -EIO;
+		/* start from the newest back-end frame */
+		fe->be_ptr = READ_ONCE(be->runtime->status->hw_ptr);
+		smp_wmb();
+		WRITE_ONCE(fe->running, 1);
+		break;
+	case SNDRV_PCM_TRIGGER_STOP:
+	case SNDRV_PCM_TRIGGER_SUSPEND:
+	case SNDRV_PCM_TRIGGER_PAUSE_PUSH:
+		WRITE_ONCE(fe->running, 0);
+		break;
+	default:
+		return -EINVAL;
+	}
+	return 0;
+}
+
+static snd_pcm_uframes_t seeed_fe_pointer(struct snd_pcm_substream *substream)
+{
+	struct seeed_fe *fe = snd_pcm_substream_chip(substream);
+
+	return READ_ONCE(fe->pos);
+}
+
+static const struct snd_pcm_ops seeed_fe_ops = {
+	.open		= seeed_fe_open,
+	.close		= seeed_fe_close,
+	.prepare	= seeed_fe_prepare,
+	.trigger	= seeed_fe_trigger,
+	.pointer	= seeed_fe_pointer,
+};
+
+static int seeed_fe_shared_open(struct snd_pcm_substream *substream)
+{
+	struct seeed_fe_card *fec = snd_pcm_substream_chip(substream);
+	struct snd_pcm_runtime *runtime = substream->runtime;
+	size_t period_bytes = fec->be_period * fec->be_channels * sizeof(s32);
+	int ret;
+
+	/* no mmap, the buffer belongs to the back-end DMA, read() copies out of it */
+	runtime->hw.info = SNDRV_PCM_INFO_INTERLEAVED | SNDRV_PCM_INFO_BLOCK_TRANSFER;
+	runtime->hw.formats = SNDRV_PCM_FMTBIT_S32_LE;
+	runtime->hw.rates = snd_pcm_rate_to_rate_bit(fec->be_rate);
+	runtime->hw.rate_min = runtime->hw.rate_max = fec->be_rate;
+	runtime->hw.channels_min = runtime->hw.channels_max = fec->be_channels;
+	runtime->hw.period_bytes_min = runtime->hw.period_bytes_max = period_bytes;
+	runtime->hw.periods_min = runtime->hw.periods_max = fec->be_periods;
+	runtime->hw.buffer_bytes_max = period_bytes * fec->be_periods;
+
+	ret = seeed_fe_be_get(fec);
+	if (ret < 0)
+		return ret;
+
+	spin_lock_irq(&fec->lock);
+	fec->reader[substream->number] = substream;
+	fec->reader_running[substream->number] = 0;
+	spin_unlock_irq(&fec->lock);
+	return 0;
+}
+
+static int seeed_fe_shared_close(struct snd_pcm_substream *substream)
+{
+	struct seeed_fe_card *fec = snd_pcm_substream_chip(substream);
+
+	spin_lock_irq(&fec->lock);
+	fec->reader_running[substream->number] = 0;
+	fec->reader[substream->number] = NULL;
+	spin_unlock_irq(&fec->lock);
+
+	seeed_fe_be_put(fec);
+	return 0;
+}
+
+static int seeed_fe_shared_hw_params(struct snd_pcm_substream *substream,
+				     struct snd_pcm_hw_params *params)
+{
+	struct seeed_fe_card *fec = snd_pcm_substream_chip(substream);
+
+	snd_pcm_set_runtime_buffer(substream, &fec->be_buf);
+	return 0;
+}
+
+static int seeed_fe_shared_hw_free(struct snd_pcm_substream *substream)
+{
+	snd_pcm_set_runtime_buffer(substream, NULL);
+	return 0;
+}
+
+/*
+ * prepare() resets the reader to the newest back-end frame,
+ * otherwise hw_ptr would start at 0 and the first read returns stale frames.
+ */
+static int seeed_fe_shared_ioctl(struct snd_pcm_substream *substream,
+				 unsigned int cmd, void *arg)
+{
+	struct seeed_fe_card *fec = snd_pcm_substream_chip(substream);
+	struct snd_pcm_runtime *runtime = substream->runtime;
+	struct snd_pcm_substream *be = READ_ONCE(fec->be);
+
+	if (cmd != SNDRV_PCM_IOCTL1_RESET)
+		return snd_pcm_lib_ioctl(substream, cmd, arg);
+	if (!be || !be->runtime)
+		return -EIO;
+
+	runtime->status->hw_ptr = READ_ONCE(be->runtime->status->hw_ptr) %
+				  runtime->buffer_size;
+	runtime->hw_ptr_wrap = 0;
+	return 0;
+}
+
+static int seeed_fe_shared_trigger(struct snd_pcm_substream *substream, int cmd)
+{
+	struct seeed_fe_card *fec = snd_pcm_substream_chip(substream);
+
+	switch (cmd) {
+	case SNDRV_PCM_TRIGGER_START:
+	case SNDRV_PCM_TRIGGER_RESUME:
+		WRITE_ONCE(fec->reader_running[substream->number], 1);
+		break;
+	case SNDRV_PCM_TRIGGER_STOP:
+	case SNDRV_PCM_TRIGGER_SUSPEND:
+		WRITE_ONCE(fec->reader_running[substream->number], 0);
+		break;
+	default:
+		return -EINVAL;
+	}
+	return 0;
+}
+
+static snd_pcm_uframes_t seeed_fe_shared_pointer(struct snd_pcm_substream *substream)
+{
+	struct seeed_fe_card *fec = snd_pcm_substream_chip(substream);
+	struct snd_pcm_substream *be = READ_ONCE(fec->be);
+
+	if (!be || !be->runtime)
+		return SNDRV_PCM_POS_XRUN;
+	return READ_ONCE(be->runtime->status->hw_ptr) %
+	       substream->runtime->buffer_size;
+}
+
+static const struct snd_pcm_ops seeed_fe_shared_ops = {
+	.open		= seeed_fe_shared_open,
+	.close		= seeed_fe_shared_close,
+	.ioctl		= seeed_fe_shared_ioctl,
+	.hw_params	= seeed_fe_shared_hw_params,
+	.hw_free	= seeed_fe_shared_hw_free,
+	.trigger	= seeed_fe_shared_trigger,
+	.pointer	= seeed_fe_shared_pointer,
+};
+
+/*
+ * Playback front-end.
+ * The back-end playback is opened by the kernel, free running like the
+ * capture one, and written 2 periods ahead of its DMA once per period.
+ * Slots get silence while the front-end is not running.
+ */
+static int seeed_fe_pb_be_start(struct seeed_fe_card *fec)
+{
+	struct snd_pcm_hw_params *params = NULL;
+	struct snd_pcm_sw_params *sw_params = NULL;
+	struct snd_pcm_substream *be;
+	int ret;
+
+	ret = seeed_fe_be_open(fec, SNDRV_PCM_STREAM_PLAYBACK, &be);
+	if (ret < 0)
+		return ret;
+
+	params = kzalloc(sizeof(*params), GFP_KERNEL);
+	sw_params = kzalloc(sizeof(*sw_params), GFP_KERNEL);
+	if (!params || !sw_params) {
+		ret = -ENOMEM;
+		goto err;
+	}
+
+	_snd_pcm_hw_params_any(params);
+	seeed_fe_param_mask(params, SNDRV_PCM_HW_PARAM_ACCESS, SNDRV_PCM_ACCESS_MMAP_INTERLEAVED);
+	seeed_fe_param_mask(params, SNDRV_PCM_HW_PARAM_FORMAT, SNDRV_PCM_FORMAT_S32_LE);
+	seeed_fe_param_mask(params, SNDRV_PCM_HW_PARAM_SUBFORMAT, SNDRV_PCM_SUBFORMAT_STD);
+	seeed_fe_param_int(params, SNDRV_PCM_HW_PARAM_CHANNELS, fec->pb_slots);
+	seeed_fe_param_int(params, SNDRV_PCM_HW_PARAM_RATE, fec->be_rate);
+	seeed_fe_param_int(params, SNDRV_PCM_HW_PARAM_PERIOD_SIZE, fec->be_period);
+	seeed_fe_param_int(params, SNDRV_PCM_HW_PARAM_PERIODS, fec->be_periods);
+
+	ret = snd_pcm_kernel_ioctl(be, SNDRV_PCM_IOCTL_HW_PARAMS, params);
+	if (ret < 0) {
+		dev_err(fec->dev, "back-end playback hw_params %uHz/%uch/%u error %d\n",
+			fec->be_rate, fec->pb_slots, fec->be_period, ret);
+		goto err;
+	}
+
+	/* never stopped on underrun, the timer keeps it fed */
+	sw_params->tstamp_mode = SNDRV_PCM_TSTAMP_NONE;
+	sw_params->period_step = 1;
+	sw_params->avail_min = 1;
+	sw_params->start_threshold = be->runtime->boundary;
+	sw_params->stop_threshold = be->runtime->boundary;
+	ret = snd_pcm_kernel_ioctl(be, SNDRV_PCM_IOCTL_SW_PARAMS, sw_params);
+	if (ret < 0)
+		goto err;
+
+	ret = snd_pcm_kernel_ioctl(be, SNDRV_PCM_IOCTL_PREPARE, NULL);
+	if (ret < 0)
+		goto err;
+
+	memset(be->runtime->dma_area, 0, be->runtime->dma_bytes);
+	fec->pb_be_appl = 2 * fec->be_period;
+	be->runtime->control->appl_ptr = fec->pb_be_appl;
+
+	fec->pb_be = be;
+
+	ret = snd_pcm_kernel_ioctl(be, SNDRV_PCM_IOCTL_START, NULL);
+	if (ret < 0) {
+		fec->pb_be = NULL;
+		goto err;
+	}
+
+	hrtimer_start(&fec->pb_timer, fec->period_time, HRTIMER_MODE_REL_SOFT);
+
+	kfree(sw_params);
+	kfree(params);
+	dev_dbg(fec->dev, "back-end playback started\n");
+	return 0;
+
+err:
+	kfree(sw_params);
+	kfree(params);
+	seeed_fe_be_close(be);
+	return ret;
+}
+
+static void seeed_fe_pb_be_stop(struct seeed_fe_card *fec)
+{
+	struct snd_pcm_substream *be = fec->pb_be;
+
+	hrtimer_cancel(&fec->pb_timer);
+
+	snd_pcm_kernel_ioctl(be, SNDRV_PCM_IOCTL_DROP, NULL);
+	spin_lock_irq(&fec->lock);
+	fec->pb_be = NULL;
+	spin_unlock_irq(&fec->lock);
+
+	seeed_fe_be_close(be);
+	dev_dbg(fec->dev, "back-end playback stopped\n");
+}
+
+/*
+ * write back-end frames up to 2 periods ahead of its DMA,
+ * return 1 if a front-end period elapsed.
+ */
+static int seeed_fe_pb_update(struct seeed_fe_card *fec)
+{
+	struct snd_pcm_runtime *be_rt = fec->pb_be->runtime;
+	struct snd_pcm_runtime *runtime = fec->pb ? fec->pb->runtime : NULL;
+	int running = runtime && READ_ONCE(fec->pb_running);
+	snd_pcm_sframes_t n;
+	unsigned s;
+
+	n = seeed_voice_card_dma_pos(fec->pb_be) + 2 * fec->be_period - fec->pb_be_appl;
+	if (n > (snd_pcm_sframes_t)(be_rt->boundary / 2))
+		n -= be_rt->boundary;
+	else if (n < -(snd_pcm_sframes_t)(be_rt->boundary / 2))
+		n += be_rt->boundary;
+	if (n <= 0)
+		return 0;
+
+	/* too late, the DMA already played what we were about to write */
+	if (n > be_rt->buffer_size - be_rt->period_size) {
+		dev_dbg(fec->dev, "playback: late %ld frames\n", n);
+		fec->pb_be_appl = (fec->pb_be_appl + n - 2 * fec->be_period) % be_rt->boundary;
+		n = 2 * fec->be_period;
+	}
+
+	while (n-- > 0) {
+		s32 *dst = (s32 *)be_rt->dma_area +
+			(fec->pb_be_appl % be_rt->buffer_size) * be_rt->channels;
+
+		if (!running) {
+			memset(dst, 0, be_rt->channels * sizeof(s32));
+		} else if (runtime->format == SNDRV_PCM_FORMAT_S16_LE) {
+			const s16 *src = (const s16 *)runtime->dma_area + fec->pb_pos * fec->pb_channels;
+
+			for (s = 0; s < fec->pb_slots; s++)
+				dst[s] = (s32)src[fec->pb_map[s]] << 16;
+		} else {
+			const s32 *src = (const s32 *)runtime->dma_area + fec->pb_pos * fec->pb_channels;
+
+			for (s = 0; s < fec->pb_slots; s++)
+				dst[s] = src[fec->pb_map[s]];
+		}
+
+		if (++fec->pb_be_appl >= be_rt->boundary)
+			fec->pb_be_appl = 0;
+		if (running) {
+			if (++fec->pb_pos >= runtime->buffer_size)
+				fec->pb_pos = 0;
+			fec->pb_period_frames++;
+		}
+	}
+
+	if (!running || fec->pb_period_frames < runtime->period_size)
+		return 0;
+	fec->pb_period_frames %= runtime->period_size;
+	return 1;
+}
+
+static enum hrtimer_restart seeed_fe_pb_timer(struct hrtimer *timer)
+{
+	struct seeed_fe_card *fec = container_of(timer, struct seeed_fe_card, pb_timer);
+	snd_pcm_uframes_t appl;
+	unsigned long flags;
+
+	spin_lock_irqsave(&fec->lock, flags);
+	if (!fec->pb_be) {
+		spin_unlock_irqrestore(&fec->lock, flags);
+		return HRTIMER_NORESTART;
+	}
+	if (seeed_fe_pb_update(fec))
+		snd_pcm_period_elapsed(fec->pb);
+	appl = fec->pb_be_appl;
+	spin_unlock_irqrestore(&fec->lock, flags);
+
+	/*
+	 * not under fec->lock, the back-end trigger takes it inside the stream lock;
+	 * pb_be stays valid, stop cancels this timer first
+	 */
+	snd_pcm_stream_lock_irqsave(fec->pb_be, flags);
+	fec->pb_be->runtime->control->appl_ptr = appl;
+	snd_pcm_stream_unlock_irqrestore(fec->pb_be, flags);
+
+	hrtimer_forward_now(timer, fec->period_time);
+	return HRTIMER_RESTART;
+}
+
+static int seeed_fe_pb_open(struct snd_pcm_substream *substream)
+{
+	struct seeed_fe_card *fec = snd_pcm_substream_chip(substream);
+	struct snd_pcm_runtime *runtime = substream->runtime;
+	int ret;
+
+	runtime->hw = seeed_fe_hardware;
+	runtime->hw.formats = SNDRV_PCM_FMTBIT_S16_LE | SNDRV_PCM_FMTBIT_S32_LE;
+	runtime->hw.rates = snd_pcm_rate_to_rate_bit(fec->be_rate);
+	runtime->hw.rate_min = runtime->hw.rate_max = fec->be_rate;
+	runtime->hw.channels_min = runtime->hw.channels_max = fec->pb_channels;
+
+	mutex_lock(&fec->be_mutex);
+	ret = seeed_fe_pb_be_start(fec);
+	mutex_unlock(&fec->be_mutex);
+	if (ret < 0)
+		return ret;
+
+	spin_lock_irq(&fec->lock);
+	fec->pb = substream;
+	fec->pb_running = 0;
+	spin_unlock_irq(&fec->lock);
+	return 0;
+}
+
+static int seeed_fe_pb_close(struct snd_pcm_substream *substream)
+{
+	struct seeed_fe_card *fec = snd_pcm_substream_chip(substream);
+
+	spin_lock_irq(&fec->lock);
+	fec->pb_running = 0;
+	fec->pb = NULL;
+	spin_unlock_irq(&fec->lock);
+
+	mutex_lock(&fec->be_mutex);
+	seeed_fe_pb_be_stop(fec);
+	mutex_unlock(&fec->be_mutex);
+	return 0;
+}
+
+static int seeed_fe_pb_prepare(struct snd_pcm_substream *substream)
+{
+	struct seeed_fe_card *fec = snd_pcm_substream_chip(substream);
+
+	fec->pb_pos = 0;
+	fec->pb_period_frames = 0;
+	return 0;
+}
+
+static int seeed_fe_pb_trigger(struct snd_pcm_substream *substream, int cmd)
+{
+	struct seeed_fe_card *fec = snd_pcm_substream_chip(substream);
+
+	switch (cmd) {
+	case SNDRV_PCM_TRIGGER_START:
+	case SNDRV_PCM_TRIGGER_RESUME:
+	case SNDRV_PCM_TRIGGER_PAUSE_RELEASE:
+		WRITE_ONCE(fec->pb_running, 1);
+		break;
+	case SNDRV_PCM_TRIGGER_STOP:
+	case SNDRV_PCM_TRIGGER_SUSPEND:
+	case SNDRV_PCM_TRIGGER_PAUSE_PUSH:
+		WRITE_ONCE(fec->pb_running, 0);
+		break;
+	default:
+		return -EINVAL;
+	}
+	return 0;
+}
+
+static snd_pcm_uframes_t seeed_fe_pb_pointer(struct snd_pcm_substream *substream)
+{
+	struct seeed_fe_card *fec = snd_pcm_substream_chip(substream);
+
+	return READ_ONCE(fec->pb_pos);
+}
+
+static const struct snd_pcm_ops seeed_fe_pb_ops = {
+	.open		= seeed_fe_pb_open,
+	.close		= seeed_fe_pb_close,
+	.prepare	= seeed_fe_pb_prepare,
+	.trigger	= seeed_fe_pb_trigger,
+	.pointer	= seeed_fe_pb_pointer,
+};
+
+static int seeed_fe_parse_one(struct seeed_fe_card *fec, struct seeed_fe *fe,
+			      struct device_node *np)
+{
+	struct device *dev = fec->dev;
+	const char *format = NULL;
+	int i, n;
+
+	fe->fec = fec;
+	fe->name = np->name;
+	spin_lock_init(&fe->lock);
+
+	n = of_property_count_u32_elems(np, "channel-map");
+	if (n > 0) {
+		if (n > SEEED_FE_CHANNELS_MAX)
+			return -EINVAL;
+		of_property_read_u32_array(np, "channel-map", fe->channel_map, n);
+		fe->channels = n;
+	} else {
+		fe->channels = fec->be_channels;
+		for (i = 0; i < fe->channels; i++)
+			fe->channel_map[i] = i;
+	}
+	for (i = 0; i < fe->channels; i++) {
+		if (fe->channel_map[i] >= fec->be_channels)
+			fe->ref = 1;
+		if (fe->channel_map[i] >= fec->be_channels + fec->ref_channels) {
+			dev_err(dev, "front-end %s: channel %u out of range\n",
+				fe->name, fe->channel_map[i]);
+			return -EINVAL;
+		}
+	}
+	/* at most the back-end buffer is converted per tick */
+	if (fe->ref) {
+		fe->ref_buf = devm_kcalloc(dev, fec->be_period * fec->be_periods * fec->ref_channels,
+					   sizeof(s32), GFP_KERNEL);
+		if (!fe->ref_buf)
+			return -ENOMEM;
+	}
+
+	fe->rate = fec->be_rate;
+	of_property_read_u32(np, "rate", &fe->rate);
+	if (!fe->rate || fec->be_rate % fe->rate) {
+		dev_err(dev, "front-end %s: rate %u isn't a divisor of %u\n",
+			fe->name, fe->rate, fec->be_rate);
+		return -EINVAL;
+	}
+	fe->decimation = fec->be_rate / fe->rate;
+	if (fe->decimation > 1) {
+		for (i = 0; i < ARRAY_SIZE(seeed_fe_firs); i++) {
+			if (seeed_fe_firs[i].decimation == fe->decimation)
+				break;
+		}
+		if (i >= ARRAY_SIZE(seeed_fe_firs)) {
+			dev_err(dev, "front-end %s: no filter for %u -> %u\n",
+				fe->name, fec->be_rate, fe->rate);
+			return -EINVAL;
+		}
+		fe->fir = seeed_fe_firs[i].fir;
+		fe->taps = seeed_fe_firs[i].taps;
+		fe->hist = devm_kcalloc(dev, fe->channels * 2 * fe->taps, sizeof(s32), GFP_KERNEL);
+		if (!fe->hist)
+			return -ENOMEM;
+	}
+
+	fe->format = SNDRV_PCM_FORMAT_S32_LE;
+	of_property_read_string(np, "format", &format);
+	if (format && !strcmp(format, "s16_le"))
+		fe->format = SNDRV_PCM_FORMAT_S16_LE;
+	else if (format && strcmp(format, "s32_le")) {
+		dev_err(dev, "front-end %s: unsupported format %s\n", fe->name, format);
+		return -EINVAL;
+	}
+
+	dev_dbg(dev, "front-end %s: %uch %uHz %s\n", fe->name, fe->channels, fe->rate,
+		fe->format == SNDRV_PCM_FORMAT_S16_LE ? "s16_le" : "s32_le");
+	return 0;
+}
+
+int seeed_voice_card_fe_parse_of(struct device *dev, struct device_node *node,
+				 struct seeed_fe_card **pfec)
+{
+	struct seeed_fe_card *fec;
+	struct device_node *np;
+	int ret;
+
+	fec = devm_kzalloc(dev, sizeof(*fec), GFP_KERNEL);
+	if (!fec)
+		return -ENOMEM;
+
+	fec->dev = dev;
+	fec->be_device = 0;
+	fec->be_rate = 48000;
+	fec->be_channels = 8;
+	fec->be_periods = 4;
+	of_property_read_u32(node, "rate", &fec->be_rate);
+	of_property_read_u32(node, "channels", &fec->be_channels);
+	fec->be_period = fec->be_rate / 100;
+	of_property_read_u32(node, "period-frames", &fec->be_period);
+	of_property_read_u32(node, "periods", &fec->be_periods);
+	of_property_read_u32(node, "shared-readers", &fec->readers);
+	if (fec->readers > SEEED_FE_READERS_MAX) {
+		dev_err(dev, "%u shared readers, max %d\n", fec->readers, SEEED_FE_READERS_MAX);
+		return -EINVAL;
+	}
+	if (fec->be_channels > SEEED_FE_CHANNELS_MAX) {
+		dev_err(dev, "%u back-end channels, max %d\n", fec->be_channels, SEEED_FE_CHANNELS_MAX);
+		return -EINVAL;
+	}
+	ret = of_property_count_u32_elems(node, "aec-reference");
+	if (ret > 0) {
+		if (ret > SEEED_FE_REF_MAX) {
+			dev_err(dev, "%d reference channels, max %d\n", ret, SEEED_FE_REF_MAX);
+			return -EINVAL;
+		}
+		of_property_read_u32_array(node, "aec-reference", fec->ref_map, ret);
+		fec->ref_channels = ret;
+		of_property_read_u32(node, "aec-reference-delay", &fec->ref_delay);
+	}
+	ret = of_property_count_u32_elems(node, "playback-slot-map");
+	if (ret > 0) {
+		int i;
+
+		if (ret > SEEED_FE_CHANNELS_MAX) {
+			dev_err(dev, "%d playback slots, max %d\n", ret, SEEED_FE_CHANNELS_MAX);
+			return -EINVAL;
+		}
+		of_property_read_u32_array(node, "playback-slot-map", fec->pb_map, ret);
+		fec->pb_slots = ret;
+		for (i = 0; i < ret; i++)
+			fec->pb_channels = max(fec->pb_channels, fec->pb_map[i] + 1);
+		if (fec->pb_channels > ret) {
+			dev_err(dev, "playback-slot-map: front-end channel out of range\n");
+			return -EINVAL;
+		}
+	}
+
+	for_each_child_of_node(node, np) {
+		if (fec->fe_cnt >= SEEED_FE_MAX) {
+			of_node_put(np);
+			return -EINVAL;
+		}
+		ret = seeed_fe_parse_one(fec, &fec->fe[fec->fe_cnt], np);
+		if (ret < 0) {
+			of_node_put(np);
+			return ret;
+		}
+		fec->fe_cnt++;
+	}
+
+	mutex_init(&fec->be_mutex);
+	spin_lock_init(&fec->lock);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6,13,0)
+	hrtimer_setup(&fec->timer, seeed_fe_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL_SOFT);
+#else
+	hrtimer_init(&fec->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL_SOFT);
+	fec->timer.function = seeed_fe_timer;
+#endif
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6,13,0)
+	hrtimer_setup(&fec->pb_timer, seeed_fe_pb_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL_SOFT);
+#else
+	hrtimer_init(&fec->pb_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL_SOFT);
+	fec->pb_timer.function = seeed_fe_pb_timer;
+#endif
+	fec->period_time = ns_to_ktime(div_u64((u64)fec->be_period * NSEC_PER_SEC, fec->be_rate));
+
+	*pfec = fec;
+	return 0;
+}
+
+/*
+ * called from card late_probe(), front-end devices follow the dai-link ones
+ */
+int seeed_voice_card_fe_new(struct snd_soc_card *card, struct seeed_fe_card *fec)
+{
+	char name[64];
+	int i, ret;
+
+	fec->card = card;
+
+	for (i = 0; i < fec->fe_cnt; i++) {
+		struct seeed_fe *fe = &fec->fe[i];
+
+		snprintf(name, sizeof(name), "seeed-fe-%s", fe->name);
+		ret = snd_pcm_new(card->snd_card, name, card->num_links + i, 0, 1, &fe->pcm);
+		if (ret < 0) {
+			dev_err(fec->dev, "front-end %s: snd_pcm_new error %d\n", fe->name, ret);
+			return ret;
+		}
+
+		fe->pcm->private_data = fe;
+		strscpy(fe->pcm->name, name, sizeof(fe->pcm->name));
+		snd_pcm_set_ops(fe->pcm, SNDRV_PCM_STREAM_CAPTURE, &seeed_fe_ops);
+		snd_pcm_set_managed_buffer_all(fe->pcm, SNDRV_DMA_TYPE_VMALLOC, NULL, 0, 0);
+	}
+
+	if (fec->readers) {
+		ret = snd_pcm_new(card->snd_card, "seeed-fe-shared", card->num_links + i,
+				  0, fec->readers, &fec->shared_pcm);
+		if (ret < 0) {
+			dev_err(fec->dev, "shared device: snd_pcm_new error %d\n", ret);
+			return ret;
+		}
+
+		fec->shared_pcm->private_data = fec;
+		strscpy(fec->shared_pcm->name, "seeed-fe-shared", sizeof(fec->shared_pcm->name));
+		snd_pcm_set_ops(fec->shared_pcm, SNDRV_PCM_STREAM_CAPTURE, &seeed_fe_shared_ops);
+		i++;
+	}
+
+	if (fec->pb_slots) {
+		ret = snd_pcm_new(card->snd_card, "seeed-fe-playback", card->num_links + i,
+				  1, 0, &fec->pb_pcm);
+		if (ret < 0) {
+			dev_err(fec->dev, "playback front-end: snd_pcm_new error %d\n", ret);
+			return ret;
+		}
+
+		fec->pb_pcm->private_data = fec;
+		strscpy(fec->pb_pcm->name, "seeed-fe-playback", sizeof(fec->pb_pcm->name));
+		snd_pcm_set_ops(fec->pb_pcm, SNDRV_PCM_STREAM_PLAYBACK, &seeed_fe_pb_ops);
+		snd_pcm_set_managed_buffer_all(fec->pb_pcm, SNDRV_DMA_TYPE_VMALLOC, NULL, 0, 0);
+	}
+	return 0;
+}
+
+/*
+ * called from the dai-link trigger, atomic
+ */
+void seeed_voice_card_fe_playback(struct seeed_fe_card *fec,
+				  struct snd_pcm_substream *substream, int running)
+{
+	unsigned long flags;
+	unsigned c;
+
+	if (!fec->ref_channels || substream->pcm->device != fec->be_device)
+		return;
+
+	/* the reference reads these channels of each playback frame */
+	for (c = 0; running && c < fec->ref_channels; c++) {
+		if (fec->ref_map[c] >= substream->runtime->channels) {
+			dev_warn_ratelimited(fec->dev, "aec-reference channel %u, playback has %u, no reference\n",
+					     fec->ref_map[c], substream->runtime->channels);
+			return;
+		}
+	}
+
+	spin_lock_irqsave(&fec->lock, flags);
+	if (running) {
+		fec->play = substream;
+		fec->ref_lock = 1;
+	} else if (fec->play == substream) {
+		fec->play = NULL;
+	}
+	spin_unlock_irqrestore(&fec->lock, flags);
+}
+
+void seeed_voice_card_fe_free(struct seeed_fe_card *fec)
+{
+	hrtimer_cancel(&fec->timer);
+	hrtimer_cancel(&fec->pb_timer);
+}
@@ -0,0 +1,40 @@
+/*
+ * SEEED voice card front-ends
+ *
+ * (C) Copyright 2017-2018
+ * Seeed Technology Co., Ltd. <www.seeedstudio.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#ifndef __SEEED_VOICECARD_FE_H__
+#define __SEEED_VOICECARD_FE_H__
+
+#include <linux/device.h>
+#include <linux/of.h>
+#include <sound/soc.h>
+
+struct seeed_fe_card;
+
+/*
+ * Front-end PCM devices over the capture back-end (dai-link 0).
+ *
+ * The back-end is opened and run by the kernel while any front-end is open,
+ * each front-end gets its own channel subset, rate and format.
+ * An optional shared device has one substream per reader, all reading
+ * the back-end DMA buffer in place.
+ * Playback of the back-end dai-link can be added as AEC reference channels,
+ * seeed_voice_card_fe_playback() tells when it runs.
+ */
+int seeed_voice_card_fe_parse_of(struct device *dev, struct device_node *node,
+				 struct seeed_fe_card **pfec);
+int seeed_voice_card_fe_new(struct snd_soc_card *card, struct seeed_fe_card *fec);
+void seeed_voice_card_fe_playback(struct seeed_fe_card *fec,
+				  struct snd_pcm_substream *substream, int running);
+void seeed_voice_card_fe_free(struct seeed_fe_card *fec);
+
+/* DMA position of a running stream now, in its hw_ptr space */
+snd_pcm_uframes_t seeed_voice_card_dma_pos(struct snd_pcm_substream *substream);
+
+#endif//__SEEED_VOICECARD_FE_H__
@@ -18,15 +18,25 @@
 #include <linux/clk.h>
 #include <linux/device.h>
 #include <linux/gpio.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/list.h>
 #include <linux/module.h>
 #include <linux/of.h>
 #include <linux/of_gpio.h>
 #include <linux/platform_device.h>
 #include <linux/string.h>
+#include <linux/math64.h>
+#include <sound/info.h>
+#include <sound/pcm_params.h>
 #include <sound/soc.h>
 #include <sound/soc-dai.h>
 #include <sound/simple_card_utils.h>
 #include "ac10x.h"
+#include "seeed-voicecard-fe.h"
+
+#define CREATE_TRACE_POINTS
+#include "seeed_voicecard_trace.h"
 
 #define LINUX_VERSION_IS_GEQ(x1,x2,x3)	(LINUX_VERSION_CODE >= KERNEL_VERSION(x1,x2,x3))
 
@@ -45,11 +55,54 @@
 #endif
 
 /*
- * single codec:
- *	0 - allow multi codec
- *	1 - yes
+ * clock estimate of one direction of dai-link 0,
+ * rate error against CLOCK_MONOTONIC over a window of samples
  */
-#define _SINGLE_CODEC		1
+#define SEEED_CLK_TICK_MS	100
+#define SEEED_CLK_WINDOW	64	/* samples, 6.4s */
+
+struct seeed_clk_est {
+	struct snd_pcm_substream *substream;	/* running, NULL - stopped */
+	unsigned rate;
+	snd_pcm_uframes_t hw_ptr;	/* DMA position of the last sample */
+	u64 frames;			/* since start */
+	int n;				/* samples in the window */
+	int head;			/* next one */
+	u64 win_frames[SEEED_CLK_WINDOW];
+	ktime_t win_ts[SEEED_CLK_WINDOW];
+	s64 ppb;			/* rate error, averaged */
+	ktime_t origin;			/* time of frame 0 on the wire */
+};
+
+/* runs and xruns of each period size, for finding the safe minimum */
+#define SEEED_XRUN_SIZES	8
+
+struct seeed_xrun_stat {
+	snd_pcm_uframes_t period_size;	/* 0 - free entry */
+	unsigned rate;
+	unsigned starts[2];		/* [SNDRV_PCM_STREAM_*] */
+	unsigned xruns[2];
+};
+
+/* health of the card for telemetry, [SNDRV_PCM_STREAM_*] */
+#define SEEED_START_BUCKETS	8
+
+static const unsigned seeed_start_us_limit[SEEED_START_BUCKETS - 1] = {
+	100, 250, 500, 1000, 2000, 5000, 10000,
+};
+
+struct seeed_health_stat {
+	unsigned starts[2];
+	unsigned stops[2];
+	unsigned xruns[2];
+	unsigned cold[2];		/* codec clock stopped before the start */
+	unsigned warm[2];		/* running, or gated by an overrun */
+	unsigned start_us_max[2];	/* trigger start, set_clock(1) included */
+	unsigned start_us[2][SEEED_START_BUCKETS];
+	unsigned stop_deferred;		/* clock stop left to work_codec_clk */
+	unsigned stop_retries;
+	unsigned stop_failed;		/* clock kept running after TRY_STOP_MAX */
+};
 
 struct seeed_card_data {
 	struct snd_soc_card snd_card;
@@ -62,17 +115,58 @@ struct seeed_card_data {
 		unsigned int mclk_fs;
 	} *dai_props;
 	unsigned int mclk_fs;
-	unsigned channels_playback_default;
 	unsigned channels_playback_override;
-	unsigned channels_capture_default;
 	unsigned channels_capture_override;
 	struct snd_soc_dai_link *dai_link;
+	struct seeed_fe_card *fe;		/* front-ends, NULL - none */
+	int (*soc_pcm_open)(struct snd_pcm_substream *substream);
 	#if CONFIG_AC10X_TRIG_LOCK
 	spinlock_t lock;
 	#endif
 	struct work_struct work_codec_clk;
 	#define TRY_STOP_MAX	3
-	int try_stop;
+	int try_stop;				/* under xrun_lock */
+	struct snd_soc_dai *clk_dai;		/* codec clock handle of this card, set_clock() dai */
+
+	/* capture overrun, LRCK gated by work_xrun until the restart */
+	struct workqueue_struct *xrun_wq;	/* high priority, with rescuer */
+	struct work_struct work_xrun;
+	spinlock_t xrun_lock;			/* the fields below, and the gating write */
+	#define SEEED_XRUN_NONE	0
+	#define SEEED_XRUN_QUEUED	1		/* work_xrun not started yet */
+	#define SEEED_XRUN_GATED	2
+	int xrun_state;
+	ktime_t xrun_ts;			/* 0 - no recovery pending */
+	unsigned xrun_recovers;
+	unsigned xrun_recover_us;		/* last overrun stop to restart */
+	unsigned xrun_recover_max_us;
+	unsigned xrun_fallbacks;		/* gating failed, full clock stop */
+
+	/* sync group, 0 - not grouped */
+	u32 sync_group;
+	struct list_head sync_node;
+	int sync_armed;
+	struct snd_pcm_substream *sync_substream;
+	struct snd_soc_dai *sync_dai;
+	int sync_cmd;
+	unsigned sync_starts;			/* group releases this card took part in */
+	s64 sync_skew_ns;			/* of the last release, under seeed_sync_lock */
+	struct delayed_work sync_timeout;	/* armed alone too long, start solo */
+
+	/* clock estimate of dai-link 0, [SNDRV_PCM_STREAM_*] */
+	spinlock_t clk_lock;
+	struct hrtimer clk_timer;
+	struct seeed_clk_est clk_est[2];
+	int clk_offset_valid;
+	s64 clk_offset_ns;		/* playback frame 0 - capture frame 0, averaged */
+	ktime_t clk_ts;			/* last sample */
+
+	/* low latency profile, period time limits in us */
+	int low_latency;
+	u32 ll_period_us[2];
+	spinlock_t stat_lock;
+	struct seeed_xrun_stat xrun_stat[SEEED_XRUN_SIZES];
+	struct seeed_health_stat health;
 };
 
 struct seeed_card_info {
@@ -95,6 +189,340 @@ struct seeed_card_info {
 #define CELL	"#sound-dai-cells"
 #define PREFIX	"seeed-voice-card,"
 
+/* The highest bit clock of the TDM frame, AC108 can't output 24.576M */
+#define SEEED_BCLK_MAX		12288000
+#define SEEED_SLOT_WIDTH	32
+/* bcm2835 I2S FIFO, 64 x 32bit words, DMA moves it in whole bursts */
+#define SEEED_I2S_FIFO_BYTES	256
+
+/* bits of a channel on the wire, the TDM slot, or the sample if no slots are set */
+static unsigned seeed_voice_card_slot_width(struct seeed_dai_props *dai_props,
+					    struct snd_pcm_hw_params *params)
+{
+	struct snd_interval *b = hw_param_interval(params, SNDRV_PCM_HW_PARAM_SAMPLE_BITS);
+
+	if (dai_props->cpu_dai.slot_width)
+		return dai_props->cpu_dai.slot_width;
+	return b->min ? b->min : SEEED_SLOT_WIDTH;
+}
+
+/*
+ * rate * channels * slot_width should be carried by the TDM bit clock
+ */
+static int seeed_voice_card_hw_rule_rate(struct snd_pcm_hw_params *params,
+					 struct snd_pcm_hw_rule *rule)
+{
+	struct seeed_dai_props *dai_props = rule->private;
+	struct snd_interval *c = hw_param_interval(params, SNDRV_PCM_HW_PARAM_CHANNELS);
+	struct snd_interval *r = hw_param_interval(params, SNDRV_PCM_HW_PARAM_RATE);
+	struct snd_interval t;
+
+	if (!c->min)
+		return 0;
+
+	snd_interval_any(&t);
+	t.max = SEEED_BCLK_MAX / (c->min * seeed_voice_card_slot_width(dai_props, params));
+	return snd_interval_refine(r, &t);
+}
+
+static int seeed_voice_card_hw_rule_channels(struct snd_pcm_hw_params *params,
+					     struct snd_pcm_hw_rule *rule)
+{
+	struct seeed_dai_props *dai_props = rule->private;
+	struct snd_interval *c = hw_param_interval(params, SNDRV_PCM_HW_PARAM_CHANNELS);
+	struct snd_interval *r = hw_param_interval(params, SNDRV_PCM_HW_PARAM_RATE);
+	struct snd_interval t;
+
+	if (!r->min)
+		return 0;
+
+	snd_interval_any(&t);
+	t.max = SEEED_BCLK_MAX / (r->min * seeed_voice_card_slot_width(dai_props, params));
+	return snd_interval_refine(c, &t);
+}
+
+/*
+ * the format, by its sample bits: no wider than a TDM slot,
+ * without slots the samples are on the wire and share the bit clock
+ */
+static int seeed_voice_card_hw_rule_bits(struct snd_pcm_hw_params *params,
+					 struct snd_pcm_hw_rule *rule)
+{
+	struct seeed_dai_props *dai_props = rule->private;
+	struct snd_interval *c = hw_param_interval(params, SNDRV_PCM_HW_PARAM_CHANNELS);
+	struct snd_interval *r = hw_param_interval(params, SNDRV_PCM_HW_PARAM_RATE);
+	struct snd_interval *b = hw_param_interval(params, SNDRV_PCM_HW_PARAM_SAMPLE_BITS);
+	struct snd_interval t;
+
+	snd_interval_any(&t);
+	if (dai_props->cpu_dai.slot_width)
+		t.max = dai_props->cpu_dai.slot_width;
+	else if (c->min && r->min)
+		t.max = SEEED_BCLK_MAX / (c->min * r->min);
+	else
+		return 0;
+	return snd_interval_refine(b, &t);
+}
+
+/*
+ * Advertise every (channels, rate, format) the slot plan can carry,
+ * instead of forcing one channel count per card.
+ */
+static int seeed_voice_card_hw_constraints(struct snd_pcm_substream *substream,
+					   struct seeed_card_data *priv,
+					   struct seeed_dai_props *dai_props)
+{
+	struct snd_pcm_runtime *runtime = substream->runtime;
+	unsigned channels_max, step;
+	int ret;
+
+	if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK)
+		channels_max = priv->channels_playback_override;
+	else
+		channels_max = priv->channels_capture_override;
+
+	/* cpu_dai fifo is fed by whole frames of its TDM slots */
+	step = dai_props->cpu_dai.slots ? dai_props->cpu_dai.slots : 1;
+	ret = snd_pcm_hw_constraint_minmax(runtime, SNDRV_PCM_HW_PARAM_CHANNELS,
+					   step, channels_max);
+	if (ret < 0)
+		return ret;
+
+	ret = snd_pcm_hw_constraint_step(runtime, 0, SNDRV_PCM_HW_PARAM_CHANNELS, step);
+	if (ret < 0)
+		return ret;
+
+	ret = snd_pcm_hw_rule_add(runtime, 0, SNDRV_PCM_HW_PARAM_RATE,
+				  seeed_voice_card_hw_rule_rate, dai_props,
+				  SNDRV_PCM_HW_PARAM_CHANNELS, SNDRV_PCM_HW_PARAM_SAMPLE_BITS, -1);
+	if (ret < 0)
+		return ret;
+
+	ret = snd_pcm_hw_rule_add(runtime, 0, SNDRV_PCM_HW_PARAM_SAMPLE_BITS,
+				  seeed_voice_card_hw_rule_bits, dai_props,
+				  SNDRV_PCM_HW_PARAM_CHANNELS, SNDRV_PCM_HW_PARAM_RATE, -1);
+	if (ret < 0)
+		return ret;
+
+	ret = snd_pcm_hw_rule_add(runtime, 0, SNDRV_PCM_HW_PARAM_CHANNELS,
+				  seeed_voice_card_hw_rule_channels, dai_props,
+				  SNDRV_PCM_HW_PARAM_RATE, SNDRV_PCM_HW_PARAM_SAMPLE_BITS, -1);
+	if (ret < 0 || !priv->low_latency)
+		return ret;
+
+	/*
+	 * low latency, short periods of whole FIFOs,
+	 * a period is whole TDM frames by itself (channels x slot width)
+	 */
+	ret = snd_pcm_hw_constraint_step(runtime, 0, SNDRV_PCM_HW_PARAM_PERIOD_BYTES,
+					 SEEED_I2S_FIFO_BYTES);
+	if (ret < 0)
+		return ret;
+
+	ret = snd_pcm_hw_constraint_step(runtime, 0, SNDRV_PCM_HW_PARAM_BUFFER_BYTES,
+					 SEEED_I2S_FIFO_BYTES);
+	if (ret < 0)
+		return ret;
+
+	ret = snd_pcm_hw_constraint_minmax(runtime, SNDRV_PCM_HW_PARAM_PERIOD_TIME,
+					   priv->ll_period_us[0], priv->ll_period_us[1]);
+	if (ret < 0)
+		return ret;
+
+	return snd_pcm_hw_constraint_minmax(runtime, SNDRV_PCM_HW_PARAM_PERIODS, 2, 4);
+}
+
+/*
+ * called from trigger, atomic;
+ * stopped by the core with the buffer full/empty, not by the application
+ */
+static int seeed_voice_card_is_xrun(struct snd_pcm_substream *substream)
+{
+	struct snd_pcm_runtime *runtime = substream->runtime;
+	snd_pcm_uframes_t avail;
+
+	if (runtime->status->state != SNDRV_PCM_STATE_RUNNING)
+		return 0;
+	if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK)
+		avail = snd_pcm_playback_avail(runtime);
+	else
+		avail = snd_pcm_capture_avail(runtime);
+	return avail >= runtime->stop_threshold;
+}
+
+static void seeed_voice_card_xrun_stat(struct seeed_card_data *priv,
+				       struct snd_pcm_substream *substream, int start)
+{
+	struct snd_pcm_runtime *runtime = substream->runtime;
+	struct seeed_xrun_stat *st = NULL;
+	unsigned long flags;
+	int i;
+
+	if (!start && !seeed_voice_card_is_xrun(substream))
+		return;
+
+	spin_lock_irqsave(&priv->stat_lock, flags);
+	for (i = 0; i < SEEED_XRUN_SIZES; i++) {
+		st = &priv->xrun_stat[i];
+		if (st->period_size == runtime->period_size && st->rate == runtime->rate)
+			break;
+		if (!st->period_size) {
+			st->period_size = runtime->period_size;
+			st->rate = runtime->rate;
+			break;
+		}
+	}
+	if (i < SEEED_XRUN_SIZES) {
+		if (start)
+			st->starts[substream->stream]++;
+		else
+			st->xruns[substream->stream]++;
+	}
+	spin_unlock_irqrestore(&priv->stat_lock, flags);
+}
+
+/*
+ * /proc/asound/cardN/xruns, one line per period size
+ */
+static void seeed_voice_card_xrun_proc(struct snd_info_entry *entry,
+				       struct snd_info_buffer *buffer)
+{
+	struct seeed_card_data *priv = entry->private_data;
+	struct seeed_xrun_stat st[SEEED_XRUN_SIZES];
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&priv->stat_lock, flags);
+	memcpy(st, priv->xrun_stat, sizeof(st));
+	spin_unlock_irqrestore(&priv->stat_lock, flags);
+
+	snd_iprintf(buffer, "period  rate    period_us  play_starts play_xruns  capt_starts capt_xruns\n");
+	for (i = 0; i < SEEED_XRUN_SIZES && st[i].period_size; i++) {
+		snd_iprintf(buffer, "%-7lu %-7u %-10u %-11u %-11u %-11u %u\n",
+			    st[i].period_size, st[i].rate,
+			    (unsigned)div_u64((u64)st[i].period_size * USEC_PER_SEC, st[i].rate),
+			    st[i].starts[SNDRV_PCM_STREAM_PLAYBACK], st[i].xruns[SNDRV_PCM_STREAM_PLAYBACK],
+			    st[i].starts[SNDRV_PCM_STREAM_CAPTURE], st[i].xruns[SNDRV_PCM_STREAM_CAPTURE]);
+	}
+}
+
+/*
+ * /proc/asound/cardN/recovery, capture overruns recovered by gating LRCK
+ */
+static void seeed_voice_card_recovery_proc(struct snd_info_entry *entry,
+					   struct snd_info_buffer *buffer)
+{
+	struct seeed_card_data *priv = entry->private_data;
+	unsigned recovers, last_us, max_us, fallbacks;
+	unsigned long flags;
+
+	spin_lock_irqsave(&priv->xrun_lock, flags);
+	recovers = priv->xrun_recovers;
+	last_us = priv->xrun_recover_us;
+	max_us = priv->xrun_recover_max_us;
+	fallbacks = priv->xrun_fallbacks;
+	spin_unlock_irqrestore(&priv->xrun_lock, flags);
+
+	snd_iprintf(buffer, "recovers\t%u\n", recovers);
+	snd_iprintf(buffer, "last_us\t\t%u\n", last_us);
+	snd_iprintf(buffer, "max_us\t\t%u\n", max_us);
+	snd_iprintf(buffer, "fallbacks\t%u\n", fallbacks);
+}
+
+/* clock: state before the start, AC10X_CLOCK_STATE, < 0 - no codec clock */
+static void seeed_voice_card_health_start(struct seeed_card_data *priv, int stream,
+					  int clock, u64 ns)
+{
+	struct seeed_health_stat *h = &priv->health;
+	unsigned us = div_u64(ns, NSEC_PER_USEC);
+	unsigned long flags;
+	int i;
+
+	for (i = 0; i < SEEED_START_BUCKETS - 1; i++) {
+		if (us < seeed_start_us_limit[i])
+			break;
+	}
+
+	spin_lock_irqsave(&priv->stat_lock, flags);
+	h->starts[stream]++;
+	h->start_us[stream][i]++;
+	if (us > h->start_us_max[stream])
+		h->start_us_max[stream] = us;
+	if (clock == 0)
+		h->cold[stream]++;
+	else if (clock > 0)
+		h->warm[stream]++;
+	spin_unlock_irqrestore(&priv->stat_lock, flags);
+}
+
+/* stream < 0 - the clock stop deferred to work_codec_clk */
+static void seeed_voice_card_health_stop(struct seeed_card_data *priv, int stream, int xrun)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&priv->stat_lock, flags);
+	if (stream < 0) {
+		priv->health.stop_deferred++;
+	} else {
+		priv->health.stops[stream]++;
+		if (xrun)
+			priv->health.xruns[stream]++;
+	}
+	spin_unlock_irqrestore(&priv->stat_lock, flags);
+}
+
+/*
+ * /proc/asound/cardN/health, totals since the card was registered
+ */
+static void seeed_voice_card_health_proc(struct snd_info_entry *entry,
+					 struct snd_info_buffer *buffer)
+{
+	struct seeed_card_data *priv = entry->private_data;
+	struct seeed_health_stat h;
+	unsigned recovers, fallbacks;
+	unsigned long flags;
+	char name[24];
+	int i;
+
+	spin_lock_irqsave(&priv->stat_lock, flags);
+	h = priv->health;
+	spin_unlock_irqrestore(&priv->stat_lock, flags);
+
+	spin_lock_irqsave(&priv->xrun_lock, flags);
+	recovers = priv->xrun_recovers;
+	fallbacks = priv->xrun_fallbacks;
+	spin_unlock_irqrestore(&priv->xrun_lock, flags);
+
+#define HEALTH_LINE(name, v) \
+	snd_iprintf(buffer, "%-16s %-11u %u\n", name, \
+		    (v)[SNDRV_PCM_STREAM_PLAYBACK], (v)[SNDRV_PCM_STREAM_CAPTURE])
+
+	snd_iprintf(buffer, "%-16s %-11s %s\n", "stream", "playback", "capture");
+	HEALTH_LINE("starts", h.starts);
+	HEALTH_LINE("stops", h.stops);
+	HEALTH_LINE("xruns", h.xruns);
+	HEALTH_LINE("cold_starts", h.cold);
+	HEALTH_LINE("warm_starts", h.warm);
+	HEALTH_LINE("start_max_us", h.start_us_max);
+	for (i = 0; i < SEEED_START_BUCKETS; i++) {
+		if (i < SEEED_START_BUCKETS - 1)
+			snprintf(name, sizeof name, "start_us<%u", seeed_start_us_limit[i]);
+		else
+			snprintf(name, sizeof name, "start_us>=%u", seeed_start_us_limit[i - 1]);
+		snd_iprintf(buffer, "%-16s %-11u %u\n", name,
+			    h.start_us[SNDRV_PCM_STREAM_PLAYBACK][i], h.start_us[SNDRV_PCM_STREAM_CAPTURE][i]);
+	}
+#undef HEALTH_LINE
+
+	snd_iprintf(buffer, "%-16s %u\n", "stop_deferred", h.stop_deferred);
+	snd_iprintf(buffer, "%-16s %u\n", "stop_retries", h.stop_retries);
+	snd_iprintf(buffer, "%-16s %u\n", "stop_failed", h.stop_failed);
+	snd_iprintf(buffer, "%-16s %u\n", "xrun_recovers", recovers);
+	snd_iprintf(buffer, "%-16s %u\n", "xrun_fallbacks", fallbacks);
+}
+
+static void seeed_voice_card_xrun_end(struct seeed_card_data *priv);
+
 static int seeed_voice_card_startup(struct snd_pcm_substream *substream)
 {
 	struct snd_soc_pcm_runtime *rtd = substream->private_data;
@@ -107,21 +535,23 @@ static int seeed_voice_card_startup(struct snd_pcm_substream *substream)
 	if (ret)
 		return ret;
 
+	if (rtd->num == 0)
+		priv->clk_dai = asoc_rtd_to_codec(rtd, 0);
+
 	ret = clk_prepare_enable(dai_props->codec_dai.clk);
 	if (ret)
-		clk_disable_unprepare(dai_props->cpu_dai.clk);
+		goto err_cpu_clk;
 
-	if (asoc_rtd_to_cpu(rtd, 0)->driver->playback.channels_min) {
-		priv->channels_playback_default = asoc_rtd_to_cpu(rtd, 0)->driver->playback.channels_min;
-	}
-	if (asoc_rtd_to_cpu(rtd, 0)->driver->capture.channels_min) {
-		priv->channels_capture_default = asoc_rtd_to_cpu(rtd, 0)->driver->capture.channels_min;
-	}
-	asoc_rtd_to_cpu(rtd, 0)->driver->playback.channels_min = priv->channels_playback_override;
-	asoc_rtd_to_cpu(rtd, 0)->driver->playback.channels_max = priv->channels_playback_override;
-	asoc_rtd_to_cpu(rtd, 0)->driver->capture.channels_min = priv->channels_capture_override;
-	asoc_rtd_to_cpu(rtd, 0)->driver->capture.channels_max = priv->channels_capture_override;
+	ret = seeed_voice_card_hw_constraints(substream, priv, dai_props);
+	if (ret < 0)
+		goto err_codec_clk;
+
+	return 0;
 
+err_codec_clk:
+	clk_disable_unprepare(dai_props->codec_dai.clk);
+err_cpu_clk:
+	clk_disable_unprepare(dai_props->cpu_dai.clk);
 	return ret;
 }
 
@@ -132,10 +562,9 @@ static void seeed_voice_card_shutdown(struct snd_pcm_substream *substream)
 	struct seeed_dai_props *dai_props =
 		seeed_priv_to_props(priv, rtd->num);
 
-	asoc_rtd_to_cpu(rtd, 0)->driver->playback.channels_min = priv->channels_playback_default;
-	asoc_rtd_to_cpu(rtd, 0)->driver->playback.channels_max = priv->channels_playback_default;
-	asoc_rtd_to_cpu(rtd, 0)->driver->capture.channels_min = priv->channels_capture_default;
-	asoc_rtd_to_cpu(rtd, 0)->driver->capture.channels_max = priv->channels_capture_default;
+	/* closed after an overrun without restart, LRCK gated, PLL & BCLK still on */
+	if (substream->stream == SNDRV_PCM_STREAM_CAPTURE)
+		seeed_voice_card_xrun_end(priv);
 
 	clk_disable_unprepare(dai_props->cpu_dai.clk);
 
@@ -146,13 +575,12 @@ static int seeed_voice_card_hw_params(struct snd_pcm_substream *substream,
 				      struct snd_pcm_hw_params *params)
 {
 	struct snd_soc_pcm_runtime *rtd = substream->private_data;
-	struct snd_soc_dai *codec_dai = asoc_rtd_to_codec(rtd, 0);
 	struct snd_soc_dai *cpu_dai = asoc_rtd_to_cpu(rtd, 0);
 	struct seeed_card_data *priv = snd_soc_card_get_drvdata(rtd->card);
 	struct seeed_dai_props *dai_props =
 		seeed_priv_to_props(priv, rtd->num);
 	unsigned int mclk, mclk_fs = 0;
-	int ret = 0;
+	int i, ret = 0;
 
 	if (priv->mclk_fs)
 		mclk_fs = priv->mclk_fs;
@@ -161,10 +589,12 @@ static int seeed_voice_card_hw_params(struct snd_pcm_substream *substream,
 
 	if (mclk_fs) {
 		mclk = params_rate(params) * mclk_fs;
-		ret = snd_soc_dai_set_sysclk(codec_dai, 0, mclk,
-					     SND_SOC_CLOCK_IN);
-		if (ret && ret != -ENOTSUPP)
-			goto err;
+		for (i = 0; i < rtd->num_codecs; i++) {
+			ret = snd_soc_dai_set_sysclk(asoc_rtd_to_codec(rtd, i), 0, mclk,
+						     SND_SOC_CLOCK_IN);
+			if (ret && ret != -ENOTSUPP)
+				goto err;
+		}
 
 		ret = snd_soc_dai_set_sysclk(cpu_dai, 0, mclk,
 					     SND_SOC_CLOCK_OUT);
@@ -187,36 +617,493 @@ int seeed_voice_card_register_set_clock(int stream, int (*set_clock)(int, struct
 }
 EXPORT_SYMBOL(seeed_voice_card_register_set_clock);
 
+/*
+ * Cards with the same "seeed-voice-card,sync-group" id are armed by their
+ * own capture trigger, and their codec clocks are released together by the
+ * trigger of the last armed member. Each card starts its own codec, by the
+ * dai it passes to set_clock(). A card armed for SEEED_SYNC_ARM_MS without
+ * the rest of the group is started alone.
+ */
+#define SEEED_SYNC_MAX		8
+#define SEEED_SYNC_ARM_MS	50
+
+static LIST_HEAD(seeed_sync_cards);
+static DEFINE_SPINLOCK(seeed_sync_lock);
+
+static void seeed_voice_card_sync_add(struct seeed_card_data *priv)
+{
+	unsigned long flags;
+
+	if (!priv->sync_group)
+		return;
+
+	spin_lock_irqsave(&seeed_sync_lock, flags);
+	list_add_tail(&priv->sync_node, &seeed_sync_cards);
+	spin_unlock_irqrestore(&seeed_sync_lock, flags);
+}
+
+static void seeed_voice_card_sync_del(struct seeed_card_data *priv)
+{
+	unsigned long flags;
+
+	if (!priv->sync_group)
+		return;
+
+	spin_lock_irqsave(&seeed_sync_lock, flags);
+	list_del(&priv->sync_node);
+	priv->sync_armed = 0;
+	spin_unlock_irqrestore(&seeed_sync_lock, flags);
+	cancel_delayed_work_sync(&priv->sync_timeout);
+}
+
+/*
+ * arm this card, start the codec clocks of the whole group if it's the last one.
+ * the other members' streams aren't locked here, the registers are written
+ * under seeed_sync_lock instead: a member's STOP trigger takes it in
+ * seeed_voice_card_sync_stop() before its own clock stop, and the timeout
+ * work before its start, so neither runs into the release.
+ * return 1 if the group was released.
+ */
+static int seeed_voice_card_sync_start(struct seeed_card_data *priv,
+				       struct snd_pcm_substream *substream,
+				       int cmd, struct snd_soc_dai *dai)
+{
+	struct seeed_sync_start {
+		struct seeed_card_data *priv;
+		struct snd_pcm_substream *substream;
+		struct snd_soc_dai *dai;
+		int cmd;
+	} go[SEEED_SYNC_MAX];
+	struct seeed_card_data *m;
+	unsigned long flags;
+	int members = 0, armed = 0, i, n = 0;
+	s64 t_first = 0, t_last = 0;
+
+	spin_lock_irqsave(&seeed_sync_lock, flags);
+	priv->sync_armed = 1;
+	priv->sync_substream = substream;
+	priv->sync_dai = dai;
+	priv->sync_cmd = cmd;
+
+	list_for_each_entry(m, &seeed_sync_cards, sync_node) {
+		if (m->sync_group != priv->sync_group)
+			continue;
+		members++;
+		armed += m->sync_armed;
+	}
+
+	if (armed < members) {
+		spin_unlock_irqrestore(&seeed_sync_lock, flags);
+		schedule_delayed_work(&priv->sync_timeout, msecs_to_jiffies(SEEED_SYNC_ARM_MS));
+		dev_dbg(seeed_priv_to_dev(priv), "sync group %u: armed %d/%d\n",
+			priv->sync_group, armed, members);
+		return 0;
+	}
+
+	list_for_each_entry(m, &seeed_sync_cards, sync_node) {
+		if (m->sync_group != priv->sync_group || n >= SEEED_SYNC_MAX)
+			continue;
+		go[n].priv = m;
+		go[n].substream = m->sync_substream;
+		go[n].dai = m->sync_dai;
+		go[n].cmd = m->sync_cmd;
+		n++;
+		m->sync_armed = 0;
+	}
+
+	for (i = 0; i < n; i++) {
+		cancel_delayed_work(&go[i].priv->sync_timeout);
+		_set_clock[SNDRV_PCM_STREAM_CAPTURE](1, go[i].substream, go[i].cmd, go[i].dai);
+		t_last = ktime_get_ns();
+		if (i == 0)
+			t_first = t_last;
+	}
+
+	/* between the returns of the first and the last codec clock start */
+	for (i = 0; i < n; i++) {
+		go[i].priv->sync_skew_ns = t_last - t_first;
+		go[i].priv->sync_starts++;
+	}
+	spin_unlock_irqrestore(&seeed_sync_lock, flags);
+
+	dev_dbg(seeed_priv_to_dev(priv), "sync group %u: %d cards started, skew %lld ns\n",
+		priv->sync_group, n, t_last - t_first);
+	return 1;
+}
+
+/*
+ * work_cb_sync_timeout: the rest of the group did not arm in time,
+ * start this card alone, under its stream lock like a trigger.
+ */
+static void work_cb_sync_timeout(struct work_struct *work)
+{
+	struct seeed_card_data *priv = container_of(to_delayed_work(work), struct seeed_card_data, sync_timeout);
+	struct snd_pcm_substream *substream;
+	struct snd_soc_dai *dai = NULL;
+	unsigned long flags;
+	int cmd = 0;
+
+	spin_lock_irqsave(&seeed_sync_lock, flags);
+	substream = priv->sync_armed ? priv->sync_substream : NULL;
+	spin_unlock_irqrestore(&seeed_sync_lock, flags);
+	if (!substream)
+		return;
+
+	snd_pcm_stream_lock_irq(substream);
+	spin_lock(&seeed_sync_lock);
+	if (priv->sync_armed && priv->sync_substream == substream) {
+		priv->sync_armed = 0;
+		dai = priv->sync_dai;
+		cmd = priv->sync_cmd;
+	}
+	spin_unlock(&seeed_sync_lock);
+	if (dai)
+		_set_clock[SNDRV_PCM_STREAM_CAPTURE](1, substream, cmd, dai);
+	snd_pcm_stream_unlock_irq(substream);
+
+	if (dai)
+		dev_warn(seeed_priv_to_dev(priv), "sync group %u: alone for %dms, started solo\n",
+			 priv->sync_group, SEEED_SYNC_ARM_MS);
+}
+
+static void seeed_voice_card_sync_stop(struct seeed_card_data *priv)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&seeed_sync_lock, flags);
+	priv->sync_armed = 0;
+	priv->sync_substream = NULL;
+	priv->sync_dai = NULL;
+	spin_unlock_irqrestore(&seeed_sync_lock, flags);
+	cancel_delayed_work(&priv->sync_timeout);
+}
+
 /*
  * work_cb_codec_clk: clear audio codec inner clock.
  */
 static void work_cb_codec_clk(struct work_struct *work)
 {
 	struct seeed_card_data *priv = container_of(work, struct seeed_card_data, work_codec_clk);
-	int r = 0;
+	u64 t0 = trace_seeed_voice_card_codec_clk_enabled() ? ktime_get_ns() : 0;
+	unsigned long flags;
+	int r = 0, try, retry;
 
 	if (_set_clock[SNDRV_PCM_STREAM_CAPTURE]) {
-		r = r || _set_clock[SNDRV_PCM_STREAM_CAPTURE](0, NULL, 0, NULL); /* not using 2nd to 4th arg if 1st == 0 */
+		r = r || _set_clock[SNDRV_PCM_STREAM_CAPTURE](0, NULL, 0, priv->clk_dai); /* only the dai, the codec, if 1st == 0 */
 	}
 	if (_set_clock[SNDRV_PCM_STREAM_PLAYBACK]) {
-		r = r || _set_clock[SNDRV_PCM_STREAM_PLAYBACK](0, NULL, 0, NULL); /* not using 2nd to 4th arg if 1st == 0 */
+		r = r || _set_clock[SNDRV_PCM_STREAM_PLAYBACK](0, NULL, 0, priv->clk_dai); /* only the dai, the codec, if 1st == 0 */
 	}
 
-	if (r && priv->try_stop++ < TRY_STOP_MAX) {
+	spin_lock_irqsave(&priv->xrun_lock, flags);
+	try = priv->try_stop;
+	retry = r && priv->try_stop++ < TRY_STOP_MAX;
+	spin_unlock_irqrestore(&priv->xrun_lock, flags);
+	trace_seeed_voice_card_codec_clk(try, r, t0 ? ktime_get_ns() - t0 : 0);
+
+	if (r) {
+		spin_lock_irqsave(&priv->stat_lock, flags);
+		if (try < TRY_STOP_MAX)
+			priv->health.stop_retries++;
+		else
+			priv->health.stop_failed++;
+		spin_unlock_irqrestore(&priv->stat_lock, flags);
+	}
+	if (retry) {
 		if (0 != schedule_work(&priv->work_codec_clk)) {}
 	}
 	return;
 }
 
-static int seeed_voice_card_trigger(struct snd_pcm_substream *substream, int cmd)
+/*
+ * work_cb_xrun: capture overrun, gate the frames only, a single register
+ * write, no retries; on failure the full clock stop does the resync.
+ * The write is done under xrun_lock, a restart in the trigger waits for
+ * it in seeed_voice_card_xrun_cancel() before its own set_clock() start,
+ * so the two never drive the chips at once.
+ */
+static void work_cb_xrun(struct work_struct *work)
+{
+	struct seeed_card_data *priv = container_of(work, struct seeed_card_data, work_xrun);
+
+	spin_lock_irq(&priv->xrun_lock);
+	if (priv->xrun_state != SEEED_XRUN_QUEUED) {
+		/* restarted before we ran, nothing to gate */
+		spin_unlock_irq(&priv->xrun_lock);
+		return;
+	}
+	priv->xrun_state = SEEED_XRUN_GATED;
+	if (_set_clock[SNDRV_PCM_STREAM_CAPTURE](AC10X_CLOCK_XRUN, NULL, 0, priv->clk_dai) != 0) {
+		/* as a stop from interrupt context, cancelled by the restart */
+		priv->xrun_fallbacks++;
+		priv->try_stop = 0;
+		if (0 != schedule_work(&priv->work_codec_clk)) {}
+	}
+	spin_unlock_irq(&priv->xrun_lock);
+}
+
+/*
+ * started again, atomic context: a gating write in progress is waited
+ * for on xrun_lock, one not started yet is skipped, and the set_clock()
+ * start that follows ungates.
+ */
+static void seeed_voice_card_xrun_cancel(struct seeed_card_data *priv)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&priv->xrun_lock, flags);
+	priv->xrun_state = SEEED_XRUN_NONE;
+	spin_unlock_irqrestore(&priv->xrun_lock, flags);
+}
+
+/* capture overrun, the gating queued */
+static void seeed_voice_card_xrun_queue(struct seeed_card_data *priv)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&priv->xrun_lock, flags);
+	priv->xrun_ts = ktime_get();
+	priv->xrun_state = SEEED_XRUN_QUEUED;
+	spin_unlock_irqrestore(&priv->xrun_lock, flags);
+	queue_work(priv->xrun_wq, &priv->work_xrun);
+}
+
+/* restarted after the overrun, time the recovery */
+static void seeed_voice_card_xrun_restart(struct seeed_card_data *priv)
+{
+	unsigned long flags;
+	unsigned us;
+
+	spin_lock_irqsave(&priv->xrun_lock, flags);
+	if (priv->xrun_ts) {
+		us = ktime_us_delta(ktime_get(), priv->xrun_ts);
+		priv->xrun_ts = 0;
+		priv->xrun_recovers++;
+		priv->xrun_recover_us = us;
+		if (us > priv->xrun_recover_max_us)
+			priv->xrun_recover_max_us = us;
+	}
+	spin_unlock_irqrestore(&priv->xrun_lock, flags);
+}
+
+static void seeed_voice_card_xrun_end(struct seeed_card_data *priv)
+{
+	ktime_t ts;
+
+	flush_work(&priv->work_xrun);
+	spin_lock_irq(&priv->xrun_lock);
+	priv->xrun_state = SEEED_XRUN_NONE;
+	ts = priv->xrun_ts;
+	priv->xrun_ts = 0;
+	spin_unlock_irq(&priv->xrun_lock);
+	if (!ts)
+		return;
+	if (_set_clock[SNDRV_PCM_STREAM_CAPTURE]) _set_clock[SNDRV_PCM_STREAM_CAPTURE](0, NULL, 0, priv->clk_dai); /* only the dai, the codec, if 1st == 0 */
+	if (_set_clock[SNDRV_PCM_STREAM_PLAYBACK]) _set_clock[SNDRV_PCM_STREAM_PLAYBACK](0, NULL, 0, priv->clk_dai); /* only the dai, the codec, if 1st == 0 */
+}
+
+static void seeed_voice_card_clk_sample(struct seeed_clk_est *est, snd_pcm_uframes_t pos,
+					ktime_t ts)
+{
+	struct snd_pcm_runtime *runtime = est->substream->runtime;
+	int oldest, newest;
+	u64 ns;
+	s64 d, err, ppb;
+
+	d = pos - est->hw_ptr;
+	if (d < 0)
+		d += runtime->boundary;
+	est->frames += d;
+	est->hw_ptr = pos;
+
+	est->win_frames[est->head] = est->frames;
+	est->win_ts[est->head] = ts;
+	newest = est->head;
+	if (++est->head >= SEEED_CLK_WINDOW)
+		est->head = 0;
+	if (est->n < SEEED_CLK_WINDOW)
+		est->n++;
+	oldest = est->n < SEEED_CLK_WINDOW ? 0 : est->head;
+	if (est->n < 2)
+		return;
+
+	/* frames * 1s - dt * rate, over dt * rate, in ppb */
+	d = ktime_to_ns(ktime_sub(est->win_ts[newest], est->win_ts[oldest]));
+	err = (s64)(est->win_frames[newest] - est->win_frames[oldest]) * NSEC_PER_SEC - d * est->rate;
+	ppb = div64_s64(err * 1000, max_t(s64, div_u64((u64)d * est->rate, 1000000), 1));
+	est->ppb = est->n == 2 ? ppb : est->ppb + (ppb - est->ppb) / 8;
+
+	/* frames back from now, at the estimated rate */
+	ns = mul_u64_u32_div(est->frames, NSEC_PER_SEC, est->rate);
+	ns -= div_s64((s64)div_u64(ns, 1000) * est->ppb, 1000000);
+	est->origin = ktime_sub_ns(ts, ns);
+}
+
+/*
+ * both streams are sampled under one lock with interrupts off,
+ * the DMA positions and their timestamps are within a few us
+ */
+static enum hrtimer_restart seeed_voice_card_clk_timer(struct hrtimer *timer)
+{
+	struct seeed_card_data *priv = container_of(timer, struct seeed_card_data, clk_timer);
+	struct seeed_clk_est *capt = &priv->clk_est[SNDRV_PCM_STREAM_CAPTURE];
+	struct seeed_clk_est *play = &priv->clk_est[SNDRV_PCM_STREAM_PLAYBACK];
+	unsigned long flags;
+	int i, running = 0;
+	s64 off;
+
+	spin_lock_irqsave(&priv->clk_lock, flags);
+	for (i = 0; i < ARRAY_SIZE(priv->clk_est); i++) {
+		struct seeed_clk_est *est = &priv->clk_est[i];
+		snd_pcm_uframes_t pos;
+
+		if (!est->substream)
+			continue;
+		pos = seeed_voice_card_dma_pos(est->substream);
+		priv->clk_ts = ktime_get();
+		seeed_voice_card_clk_sample(est, pos, priv->clk_ts);
+		running++;
+	}
+
+	if (capt->substream && play->substream && capt->n >= 2 && play->n >= 2) {
+		off = ktime_to_ns(ktime_sub(play->origin, capt->origin));
+		priv->clk_offset_ns = priv->clk_offset_valid ? priv->clk_offset_ns + (off - priv->clk_offset_ns) / 8 : off;
+		priv->clk_offset_valid = 1;
+	}
+	spin_unlock_irqrestore(&priv->clk_lock, flags);
+
+	if (!running)
+		return HRTIMER_NORESTART;
+	hrtimer_forward_now(timer, ms_to_ktime(SEEED_CLK_TICK_MS));
+	return HRTIMER_RESTART;
+}
+
+/*
+ * called from trigger, atomic; the start is the first sample,
+ * frames are counted from the hw_ptr of the trigger, origin is that frame
+ */
+static void seeed_voice_card_clk_run(struct seeed_card_data *priv,
+				     struct snd_pcm_substream *substream, int running)
+{
+	struct seeed_clk_est *est = &priv->clk_est[substream->stream];
+	unsigned long flags;
+
+	spin_lock_irqsave(&priv->clk_lock, flags);
+	if (running) {
+		est->substream = substream;
+		est->rate = substream->runtime->rate;
+		est->hw_ptr = substream->runtime->status->hw_ptr;
+		est->frames = 0;
+		est->win_frames[0] = 0;
+		est->win_ts[0] = ktime_get();
+		est->origin = est->win_ts[0];
+		est->n = 1;
+		est->head = 1;
+		est->ppb = 0;
+	} else if (est->substream == substream) {
+		est->substream = NULL;
+	}
+	priv->clk_offset_valid = 0;
+	spin_unlock_irqrestore(&priv->clk_lock, flags);
+
+	if (running)
+		hrtimer_start(&priv->clk_timer, ms_to_ktime(SEEED_CLK_TICK_MS), HRTIMER_MODE_REL_SOFT);
+}
+
+static void seeed_voice_card_print_ppb(struct snd_info_buffer *buffer, const char *name, s64 ppb)
+{
+	u64 a = abs(ppb);
+
+	snd_iprintf(buffer, "%-12s%c%llu.%03llu\n", name, ppb < 0 ? '-' : '+', a / 1000, a % 1000);
+}
+
+/*
+ * /proc/asound/cardN/clock
+ *   ppm: rate error of each direction against CLOCK_MONOTONIC
+ *   drift_ppm: capture - playback
+ *   offset_us: time of playback frame 0 - time of capture frame 0,
+ *              frames counted from the last start of each direction
+ *   sync skew_ns: time between the first and the last card's codec clock
+ *              start sequence returning, by CPU timestamps around the i2c
+ *              writes, an upper bound of the LRCK start skew, not a
+ *              measurement of it
+ */
+static void seeed_voice_card_clk_proc(struct snd_info_entry *entry,
+				      struct snd_info_buffer *buffer)
+{
+	struct seeed_card_data *priv = entry->private_data;
+	struct seeed_clk_est est[2];
+	unsigned long flags;
+	int i, offset_valid;
+	unsigned sync_starts;
+	s64 offset_ns, sync_skew_ns;
+	ktime_t ts;
+
+	spin_lock_irqsave(&seeed_sync_lock, flags);
+	sync_starts = priv->sync_starts;
+	sync_skew_ns = priv->sync_skew_ns;
+	spin_unlock_irqrestore(&seeed_sync_lock, flags);
+
+	if (priv->sync_group) {
+		snd_iprintf(buffer, "[sync]\n");
+		snd_iprintf(buffer, "group       %u\n", priv->sync_group);
+		snd_iprintf(buffer, "starts      %u\n", sync_starts);
+		snd_iprintf(buffer, "skew_ns     %lld\n", sync_skew_ns);
+	}
+
+	spin_lock_irqsave(&priv->clk_lock, flags);
+	memcpy(est, priv->clk_est, sizeof(est));
+	offset_valid = priv->clk_offset_valid;
+	offset_ns = priv->clk_offset_ns;
+	ts = priv->clk_ts;
+	spin_unlock_irqrestore(&priv->clk_lock, flags);
+
+	for (i = 0; i < ARRAY_SIZE(est); i++) {
+		snd_iprintf(buffer, "[%s]\n", i == SNDRV_PCM_STREAM_PLAYBACK ? "playback" : "capture");
+		snd_iprintf(buffer, "running     %d\n", est[i].substream != NULL);
+		if (!est[i].substream)
+			continue;
+		snd_iprintf(buffer, "rate        %u\n", est[i].rate);
+		snd_iprintf(buffer, "frames      %llu\n", est[i].frames);
+		if (est[i].n >= 2)
+			seeed_voice_card_print_ppb(buffer, "ppm", est[i].ppb);
+	}
+
+	if (!offset_valid)
+		return;
+	snd_iprintf(buffer, "[duplex]\n");
+	seeed_voice_card_print_ppb(buffer, "drift_ppm",
+		est[SNDRV_PCM_STREAM_CAPTURE].ppb - est[SNDRV_PCM_STREAM_PLAYBACK].ppb);
+	snd_iprintf(buffer, "offset_us   %lld\n", div_s64(offset_ns, NSEC_PER_USEC));
+	snd_iprintf(buffer, "timestamp   %lld\n", ktime_to_ns(ts));
+}
+
+static int seeed_voice_card_proc_new(struct seeed_card_data *priv, const char *name,
+				     void (*read)(struct snd_info_entry *, struct snd_info_buffer *))
+{
+	struct snd_card *card = priv->snd_card.snd_card;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5,1,0)
+	return snd_card_ro_proc_new(card, name, priv, read);
+#else
+	struct snd_info_entry *entry;
+	int ret;
+
+	ret = snd_card_proc_new(card, name, &entry);
+	if (ret < 0)
+		return ret;
+	snd_info_set_text_ops(entry, priv, read);
+	return 0;
+#endif
+}
+
+static int __seeed_voice_card_trigger(struct snd_pcm_substream *substream, int cmd)
 {
 	struct snd_soc_pcm_runtime *rtd = substream->private_data;
 	struct snd_soc_dai *dai = asoc_rtd_to_codec(rtd, 0);
 	struct seeed_card_data *priv = snd_soc_card_get_drvdata(rtd->card);
-	#if CONFIG_AC10X_TRIG_LOCK
 	unsigned long flags;
-	#endif
-	int ret = 0;
+	int clock = -1, xrun, ret = 0;
+	u64 t0;
 
 	dev_dbg(rtd->card->dev, "%s() stream=%s  cmd=%d play:%d, capt:%d\n",
 		__FUNCTION__, snd_pcm_stream_str(substream), cmd,
@@ -226,34 +1113,69 @@ static int seeed_voice_card_trigger(struct snd_pcm_substream *substream, int cmd
 	case SNDRV_PCM_TRIGGER_START:
 	case SNDRV_PCM_TRIGGER_RESUME:
 	case SNDRV_PCM_TRIGGER_PAUSE_RELEASE:
+		/* first, a failed gating write falls back to work_codec_clk */
+		seeed_voice_card_xrun_cancel(priv);
 		if (cancel_work_sync(&priv->work_codec_clk) != 0) {}
+		t0 = ktime_get_ns();
 		#if CONFIG_AC10X_TRIG_LOCK
 		/* I know it will degrades performance, but I have no choice */
 		spin_lock_irqsave(&priv->lock, flags);
 		#endif
-		if (_set_clock[SNDRV_PCM_STREAM_CAPTURE]) _set_clock[SNDRV_PCM_STREAM_CAPTURE](1, substream, cmd, dai);
+		/* warm or cold start */
+		if (_set_clock[SNDRV_PCM_STREAM_CAPTURE]) clock = _set_clock[SNDRV_PCM_STREAM_CAPTURE](AC10X_CLOCK_STATE, NULL, 0, dai);
+		if (priv->sync_group && substream->stream == SNDRV_PCM_STREAM_CAPTURE) {
+			if (_set_clock[SNDRV_PCM_STREAM_CAPTURE]) seeed_voice_card_sync_start(priv, substream, cmd, dai);
+		} else if (_set_clock[SNDRV_PCM_STREAM_CAPTURE]) _set_clock[SNDRV_PCM_STREAM_CAPTURE](1, substream, cmd, dai);
 		if (_set_clock[SNDRV_PCM_STREAM_PLAYBACK]) _set_clock[SNDRV_PCM_STREAM_PLAYBACK](1, substream, cmd, dai);
 		#if CONFIG_AC10X_TRIG_LOCK
 		spin_unlock_irqrestore(&priv->lock, flags);
 		#endif
+		seeed_voice_card_health_start(priv, substream->stream, clock, ktime_get_ns() - t0);
+		if (substream->stream == SNDRV_PCM_STREAM_CAPTURE)
+			seeed_voice_card_xrun_restart(priv);
+		if (priv->fe && substream->stream == SNDRV_PCM_STREAM_PLAYBACK)
+			seeed_voice_card_fe_playback(priv->fe, substream, 1);
+		if (rtd->num == 0)
+			seeed_voice_card_clk_run(priv, substream, 1);
+		seeed_voice_card_xrun_stat(priv, substream, 1);
 		break;
 
 	case SNDRV_PCM_TRIGGER_STOP:
 	case SNDRV_PCM_TRIGGER_SUSPEND:
 	case SNDRV_PCM_TRIGGER_PAUSE_PUSH:
+		xrun = cmd == SNDRV_PCM_TRIGGER_STOP && seeed_voice_card_is_xrun(substream);
+		seeed_voice_card_health_stop(priv, substream->stream, xrun);
+		if (priv->sync_group && substream->stream == SNDRV_PCM_STREAM_CAPTURE) {
+			seeed_voice_card_sync_stop(priv);
+		}
+		if (priv->fe && substream->stream == SNDRV_PCM_STREAM_PLAYBACK)
+			seeed_voice_card_fe_playback(priv->fe, substream, 0);
+		if (rtd->num == 0)
+			seeed_voice_card_clk_run(priv, substream, 0);
+		seeed_voice_card_xrun_stat(priv, substream, 0);
+
 		/* capture channel resync, if overrun */
 		if (dai->stream_active[SNDRV_PCM_STREAM_CAPTURE] && substream->stream == SNDRV_PCM_STREAM_PLAYBACK) {
 			break;
 		}
 
+		/* capture overrun, restarted by the application at once, gate LRCK only */
+		if (xrun && substream->stream == SNDRV_PCM_STREAM_CAPTURE && _set_clock[SNDRV_PCM_STREAM_CAPTURE]) {
+			seeed_voice_card_xrun_queue(priv);
+			break;
+		}
+
 		/* interrupt environment */
 		if (in_irq() || in_nmi() || in_serving_softirq()) {
+			spin_lock_irqsave(&priv->xrun_lock, flags);
 			priv->try_stop = 0;
+			spin_unlock_irqrestore(&priv->xrun_lock, flags);
 			if (0 != schedule_work(&priv->work_codec_clk)) {
+				seeed_voice_card_health_stop(priv, -1, 0);
 			}
 		} else {
-			if (_set_clock[SNDRV_PCM_STREAM_CAPTURE]) _set_clock[SNDRV_PCM_STREAM_CAPTURE](0, NULL, 0, NULL); /* not using 2nd to 4th arg if 1st == 0 */
-			if (_set_clock[SNDRV_PCM_STREAM_PLAYBACK]) _set_clock[SNDRV_PCM_STREAM_PLAYBACK](0, NULL, 0, NULL); /* not using 2nd to 4th arg if 1st == 0 */
+			if (_set_clock[SNDRV_PCM_STREAM_CAPTURE]) _set_clock[SNDRV_PCM_STREAM_CAPTURE](0, NULL, 0, priv->clk_dai); /* only the dai, the codec, if 1st == 0 */
+			if (_set_clock[SNDRV_PCM_STREAM_PLAYBACK]) _set_clock[SNDRV_PCM_STREAM_PLAYBACK](0, NULL, 0, priv->clk_dai); /* only the dai, the codec, if 1st == 0 */
 		}
 		break;
 	default:
@@ -267,6 +1189,20 @@ static int seeed_voice_card_trigger(struct snd_pcm_substream *substream, int cmd
 	return ret;
 }
 
+/* trigger timed, in atomic context this is time with IRQs off */
+static int seeed_voice_card_trigger(struct snd_pcm_substream *substream, int cmd)
+{
+	struct snd_soc_pcm_runtime *rtd = substream->private_data;
+	u64 t0 = trace_seeed_voice_card_trigger_enabled() ? ktime_get_ns() : 0;
+	int xrun = t0 ? seeed_voice_card_is_xrun(substream) : 0;
+	int ret;
+
+	ret = __seeed_voice_card_trigger(substream, cmd);
+	trace_seeed_voice_card_trigger(rtd->num, substream->stream, cmd, xrun, irqs_disabled(),
+				       ret, t0 ? ktime_get_ns() - t0 : 0);
+	return ret;
+}
+
 static struct snd_soc_ops seeed_voice_card_ops = {
 	.startup = seeed_voice_card_startup,
 	.shutdown = seeed_voice_card_shutdown,
@@ -410,11 +1346,14 @@ static int seeed_voice_card_dai_init(struct snd_soc_pcm_runtime *rtd)
 	struct snd_soc_dai *cpu = asoc_rtd_to_cpu(rtd, 0);
 	struct seeed_dai_props *dai_props =
 		seeed_priv_to_props(priv, rtd->num);
-	int ret;
+	int i, ret;
 
-	ret = asoc_simple_init_dai(codec, &dai_props->codec_dai);
-	if (ret < 0)
-		return ret;
+	/* multi-codec, the same sysclk & TDM slots for each chip */
+	for (i = 0; i < rtd->num_codecs; i++) {
+		ret = asoc_simple_init_dai(asoc_rtd_to_codec(rtd, i), &dai_props->codec_dai);
+		if (ret < 0)
+			return ret;
+	}
 
 	ret = asoc_simple_init_dai(cpu, &dai_props->cpu_dai);
 	if (ret < 0)
@@ -483,18 +1422,22 @@ static int seeed_voice_card_dai_link_of(struct device_node *node,
 	if (ret < 0)
 		goto dai_link_of_err;
 
-	#if _SINGLE_CODEC
-	ret = asoc_simple_parse_codec(codec, dai_link);
-	if (ret < 0)
-		goto dai_link_of_err;
-	#else
-	ret = snd_soc_of_get_dai_link_codecs(dev, codec, dai_link);
-	if (ret < 0) {
-		dev_err(dev, "parse codec info error %d\n", ret);
-		goto dai_link_of_err;
+	/*
+	 * several sound-dai of the codec node, a multi-codec dai-link,
+	 * one component per chip, the first one is the clock master.
+	 */
+	if (of_count_phandle_with_args(codec, "sound-dai", "#sound-dai-cells") > 1) {
+		ret = snd_soc_of_get_dai_link_codecs(dev, codec, dai_link);
+		if (ret < 0) {
+			dev_err(dev, "parse codec info error %d\n", ret);
+			goto dai_link_of_err;
+		}
+		dev_dbg(dev, "dai_link num_codecs = %d\n", dai_link->num_codecs);
+	} else {
+		ret = asoc_simple_parse_codec(codec, dai_link);
+		if (ret < 0)
+			goto dai_link_of_err;
 	}
-	dev_dbg(dev, "dai_link num_codecs = %d\n", dai_link->num_codecs);
-	#endif
 
 	ret = asoc_simple_parse_platform(plat, dai_link);
 	if (ret < 0)
@@ -537,11 +1480,7 @@ static int seeed_voice_card_dai_link_of(struct device_node *node,
 	ret = asoc_simple_set_dailink_name(dev, dai_link,
 						"%s-%s",
 						dai_link->cpus->dai_name,
-						#if _SINGLE_CODEC
-						dai_link->codecs->dai_name
-						#else
 						dai_link->codecs[0].dai_name
-						#endif
 	);
 	if (ret < 0)
 		goto dai_link_of_err;
@@ -555,23 +1494,15 @@ static int seeed_voice_card_dai_link_of(struct device_node *node,
 		dai_link->cpus->dai_name,
 		dai_props->cpu_dai.sysclk);
 	dev_dbg(dev, "\tcodec : %s / %d\n",
-		#if _SINGLE_CODEC
-		dai_link->codecs->dai_name,
-		#else
 		dai_link->codecs[0].dai_name,
-		#endif
 		dai_props->codec_dai.sysclk);
 
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(5,13,0)
 	asoc_simple_canonicalize_cpu(dai_link->cpus, single_cpu);
-	#if _SINGLE_CODEC
 	asoc_simple_canonicalize_platform(dai_link->platforms, dai_link->cpus);
-	#endif
 #else
 	asoc_simple_canonicalize_cpu(dai_link, single_cpu);
-	#if _SINGLE_CODEC
 	asoc_simple_canonicalize_platform(dai_link);
-	#endif
 #endif
 
 dai_link_of_err:
@@ -615,7 +1546,8 @@ static int seeed_voice_card_parse_of(struct device_node *node,
 				     struct seeed_card_data *priv)
 {
 	struct device *dev = seeed_priv_to_dev(priv);
-	struct device_node *dai_link;
+	struct device_node *dai_link, *fe_node;
+	u32 period_us[2];
 	int ret;
 
 	if (!node)
@@ -648,6 +1580,8 @@ static int seeed_voice_card_parse_of(struct device_node *node,
 		int i = 0;
 
 		for_each_child_of_node(node, np) {
+			if (!of_node_name_eq(np, PREFIX "dai-link"))
+				continue;
 			dev_dbg(dev, "\tlink %d:\n", i);
 			ret = seeed_voice_card_dai_link_of(np, priv,
 							   i, false);
@@ -670,19 +1604,39 @@ static int seeed_voice_card_parse_of(struct device_node *node,
 
 	ret = seeed_voice_card_parse_aux_devs(node, priv);
 
-	priv->channels_playback_default  = 0;
+	/* The max channels of each stream, narrowed by hw rules in startup() */
 	priv->channels_playback_override = 2;
-	priv->channels_capture_default   = 0;
 	priv->channels_capture_override  = 2;
-	of_property_read_u32(node, PREFIX "channels-playback-default",
-				    &priv->channels_playback_default);
 	of_property_read_u32(node, PREFIX "channels-playback-override",
 				    &priv->channels_playback_override);
-	of_property_read_u32(node, PREFIX "channels-capture-default",
-				    &priv->channels_capture_default);
 	of_property_read_u32(node, PREFIX "channels-capture-override",
 				    &priv->channels_capture_override);
 
+	/* Cards with the same group id start capture clocks together */
+	priv->sync_group = 0;
+	of_property_read_u32(node, PREFIX "sync-group", &priv->sync_group);
+
+	/* Short periods, 1-2ms unless given */
+	priv->low_latency = of_property_read_bool(node, PREFIX "low-latency");
+	priv->ll_period_us[0] = 1000;
+	priv->ll_period_us[1] = 2000;
+	if (of_property_read_u32_array(node, PREFIX "low-latency-period-us", period_us, 2) == 0) {
+		if (!period_us[0] || period_us[0] > period_us[1])
+			dev_warn(dev, "invalid low-latency-period-us <%u %u>, using <%u %u>\n",
+				 period_us[0], period_us[1],
+				 priv->ll_period_us[0], priv->ll_period_us[1]);
+		else
+			memcpy(priv->ll_period_us, period_us, sizeof(period_us));
+	}
+
+	/* Front-end PCM devices over the capture back-end */
+	fe_node = of_get_child_by_name(node, PREFIX "front-ends");
+	if (fe_node) {
+		if (ret >= 0)
+			ret = seeed_voice_card_fe_parse_of(dev, fe_node, &priv->fe);
+		of_node_put(fe_node);
+	}
+
 card_parse_end:
 	of_node_put(dai_link);
 
@@ -762,6 +1716,64 @@ inline void seeed_debug_info(struct seeed_card_data *priv)
 #define  seeed_debug_info(priv)
 #endif /* DEBUG */
 
+/*
+ * The cpu_dai only sees frames of its slots, the TDM frame is owned by the
+ * codec. The ASoC open limits runtime->hw to the cpu_dai channels, widen it
+ * to the override after, the hw rules of startup() do the rest.
+ */
+static int seeed_voice_card_pcm_open(struct snd_pcm_substream *substream)
+{
+	struct snd_soc_pcm_runtime *rtd = substream->private_data;
+	struct seeed_card_data *priv = snd_soc_card_get_drvdata(rtd->card);
+	struct snd_pcm_hardware *hw = &substream->runtime->hw;
+	int ret;
+
+	ret = priv->soc_pcm_open(substream);
+	if (ret < 0)
+		return ret;
+
+	if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK)
+		hw->channels_max = max(hw->channels_max, priv->channels_playback_override);
+	else
+		hw->channels_max = max(hw->channels_max, priv->channels_capture_override);
+	return 0;
+}
+
+static int seeed_voice_card_late_probe(struct snd_soc_card *card)
+{
+	struct seeed_card_data *priv = snd_soc_card_get_drvdata(card);
+	struct snd_soc_pcm_runtime *rtd;
+
+	/* ops of the card's own runtimes, the cpu_dai driver stays untouched */
+	for_each_card_rtds(card, rtd) {
+		if (rtd->dai_link->no_pcm || !rtd->pcm)
+			continue;
+		priv->soc_pcm_open = rtd->ops.open;
+		rtd->ops.open = seeed_voice_card_pcm_open;
+	}
+
+	if (!priv->fe)
+		return 0;
+	return seeed_voice_card_fe_new(card, priv->fe);
+}
+
+/* multi-codec dai-links, the references of snd_soc_of_get_dai_link_codecs() */
+static void seeed_voice_card_put_codecs(struct seeed_card_data *priv)
+{
+	struct snd_soc_dai_link *dai_link;
+	int i, j;
+
+	for (i = 0; i < priv->snd_card.num_links; i++) {
+		dai_link = &priv->dai_link[i];
+		if (dai_link->codecs == &priv->dai_props[i].codecs)
+			continue;
+		snd_soc_of_put_dai_link_codecs(dai_link);
+		/* asoc_simple_clean_reference() puts the codecs too */
+		for (j = 0; j < dai_link->num_codecs; j++)
+			dai_link->codecs[j].of_node = NULL;
+	}
+}
+
 static int seeed_voice_card_probe(struct platform_device *pdev)
 {
 	struct seeed_card_data *priv;
@@ -772,9 +1784,16 @@ static int seeed_voice_card_probe(struct platform_device *pdev)
 	int num, ret, i;
 
 	/* Get the number of DAI links */
-	if (np && of_get_child_by_name(np, PREFIX "dai-link"))
-		num = of_get_child_count(np);
-	else
+	num = 0;
+	if (np) {
+		struct device_node *child;
+
+		for_each_child_of_node(np, child) {
+			if (of_node_name_eq(child, PREFIX "dai-link"))
+				num++;
+		}
+	}
+	if (!num)
 		num = 1;
 
 	/* Allocate the private data and the DAI link array */
@@ -871,14 +1890,46 @@ static int seeed_voice_card_probe(struct platform_device *pdev)
 	#endif
 
 	INIT_WORK(&priv->work_codec_clk, work_cb_codec_clk);
+	INIT_DELAYED_WORK(&priv->sync_timeout, work_cb_sync_timeout);
+	INIT_WORK(&priv->work_xrun, work_cb_xrun);
+	spin_lock_init(&priv->xrun_lock);
+	priv->xrun_wq = alloc_workqueue("%s-xrun", WQ_HIGHPRI | WQ_MEM_RECLAIM, 1, dev_name(dev));
+	if (!priv->xrun_wq) {
+		ret = -ENOMEM;
+		goto err;
+	}
+
+	spin_lock_init(&priv->clk_lock);
+	spin_lock_init(&priv->stat_lock);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6,13,0)
+	hrtimer_setup(&priv->clk_timer, seeed_voice_card_clk_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL_SOFT);
+#else
+	hrtimer_init(&priv->clk_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL_SOFT);
+	priv->clk_timer.function = seeed_voice_card_clk_timer;
+#endif
+
+	priv->snd_card.late_probe = seeed_voice_card_late_probe;
 
 	seeed_debug_info(priv);
 
 	ret = devm_snd_soc_register_card(&pdev->dev, &priv->snd_card);
-	if (ret >= 0)
+	if (ret >= 0) {
+		seeed_voice_card_sync_add(priv);
+		if (seeed_voice_card_proc_new(priv, "clock", seeed_voice_card_clk_proc) < 0)
+			dev_warn(dev, "no clock info file\n");
+		if (seeed_voice_card_proc_new(priv, "xruns", seeed_voice_card_xrun_proc) < 0)
+			dev_warn(dev, "no xruns info file\n");
+		if (seeed_voice_card_proc_new(priv, "recovery", seeed_voice_card_recovery_proc) < 0)
+			dev_warn(dev, "no recovery info file\n");
+		if (seeed_voice_card_proc_new(priv, "health", seeed_voice_card_health_proc) < 0)
+			dev_warn(dev, "no health info file\n");
 		return ret;
+	}
 
 err:
+	if (priv->xrun_wq)
+		destroy_workqueue(priv->xrun_wq);
+	seeed_voice_card_put_codecs(priv);
 	asoc_simple_clean_reference(&priv->snd_card);
 
 	return ret;
@@ -889,8 +1940,14 @@ static int seeed_voice_card_remove(struct platform_device *pdev)
 	struct snd_soc_card *card = platform_get_drvdata(pdev);
 	struct seeed_card_data *priv = snd_soc_card_get_drvdata(card);
 
+	if (priv->fe)
+		seeed_voice_card_fe_free(priv->fe);
+	seeed_voice_card_sync_del(priv);
+	hrtimer_cancel(&priv->clk_timer);
 	if (cancel_work_sync(&priv->work_codec_clk) != 0) {
 	}
+	destroy_workqueue(priv->xrun_wq);
+	seeed_voice_card_put_codecs(priv);
 	asoc_simple_clean_reference(card);
 
 	return 0;
@@ -0,0 +1,79 @@
+/*
+ * seeed_voicecard_trace.h  --  tracepoints of the seeed voice card
+ *
+ * durations in ns, measured only while the event is enabled:
+ *   perf record -e 'seeed_voicecard:*'
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM seeed_voicecard
+
+#if !defined(__SEEED_VOICECARD_TRACE_H__) || defined(TRACE_HEADER_MULTI_READ)
+#define __SEEED_VOICECARD_TRACE_H__
+
+#include <linux/tracepoint.h>
+
+/*
+ * link: dai-link number, irqs_off: called with interrupts disabled,
+ * ns is then IRQ-off time spent in the card trigger
+ */
+TRACE_EVENT(seeed_voice_card_trigger,
+	TP_PROTO(int link, int stream, int cmd, int xrun, int irqs_off, int ret, u64 ns),
+	TP_ARGS(link, stream, cmd, xrun, irqs_off, ret, ns),
+
+	TP_STRUCT__entry(
+		__field(int, link)
+		__field(int, stream)
+		__field(int, cmd)
+		__field(int, xrun)
+		__field(int, irqs_off)
+		__field(int, ret)
+		__field(u64, ns)
+	),
+
+	TP_fast_assign(
+		__entry->link = link;
+		__entry->stream = stream;
+		__entry->cmd = cmd;
+		__entry->xrun = xrun;
+		__entry->irqs_off = irqs_off;
+		__entry->ret = ret;
+		__entry->ns = ns;
+	),
+
+	TP_printk("link=%d stream=%d cmd=%d xrun=%d irqs_off=%d ret=%d ns=%llu",
+		  __entry->link, __entry->stream, __entry->cmd, __entry->xrun,
+		  __entry->irqs_off, __entry->ret, __entry->ns)
+);
+
+/* deferred codec clock stop, try: retries so far */
+TRACE_EVENT(seeed_voice_card_codec_clk,
+	TP_PROTO(int try, int ret, u64 ns),
+	TP_ARGS(try, ret, ns),
+
+	TP_STRUCT__entry(
+		__field(int, try)
+		__field(int, ret)
+		__field(u64, ns)
+	),
+
+	TP_fast_assign(
+		__entry->try = try;
+		__entry->ret = ret;
+		__entry->ns = ns;
+	),
+
+	TP_printk("try=%d ret=%d ns=%llu",
+		  __entry->try, __entry->ret, __entry->ns)
+);
+
+#endif /* __SEEED_VOICECARD_TRACE_H__ */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE seeed_voicecard_trace
+#include <trace/define_trace.h>
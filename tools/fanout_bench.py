@@ -0,0 +1,85 @@
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+# CPU cost of N capture readers, alsa-lib dsnoop against the shared
+# front-end of the voice card (seeed-voice-card,front-ends shared-readers).
+#
+# Usage: python3 fanout_bench.py [card] [shared-device] [seconds]
+#   python3 fanout_bench.py seeed8micvoicec 3 20
+
+card = sys.argv[1] if len(sys.argv) > 1 else 'seeed8micvoicec'
+shared_dev = sys.argv[2] if len(sys.argv) > 2 else '3'
+seconds = int(sys.argv[3]) if len(sys.argv) > 3 else 20
+
+rate = 48000
+channels = 8
+readers = [2, 4, 8]
+
+asoundrc = '''
+pcm.bench_dsnoop {{
+    type dsnoop
+    ipc_key 666777
+    slave {{
+        pcm "hw:{card},0"
+        rate {rate}
+        channels {channels}
+        format S32_LE
+        period_size 480
+        buffer_size 1920
+    }}
+}}
+'''.format(card=card, rate=rate, channels=channels)
+
+hz = os.sysconf('SC_CLK_TCK')
+
+
+def system_ticks():
+    # user + nice + system + irq + softirq, all cpus
+    with open('/proc/stat') as f:
+        v = [int(x) for x in f.readline().split()[1:]]
+    return v[0] + v[1] + v[2] + v[5] + v[6]
+
+
+def process_ticks(pid):
+    with open('/proc/{}/stat'.format(pid)) as f:
+        v = f.read().rsplit(')', 1)[1].split()
+    # utime, stime, cutime, cstime
+    return int(v[11]) + int(v[12]) + int(v[13]) + int(v[14])
+
+
+def run(pcm, n, env):
+    cmd = ['arecord', '-q', '-D', pcm, '-t', 'raw', '-f', 'S32_LE',
+           '-r', str(rate), '-c', str(channels), '-d', str(seconds), '/dev/null']
+    t0 = system_ticks()
+    procs = [subprocess.Popen(cmd, env=env) for i in range(n)]
+    time.sleep(seconds - 1)
+    user = sum(process_ticks(p.pid) for p in procs)
+    t1 = system_ticks()
+    failed = 0
+    for p in procs:
+        if p.wait() != 0:
+            failed += 1
+    wall = (seconds - 1) * hz
+    return 100.0 * user / wall, 100.0 * (t1 - t0) / wall, failed
+
+
+with tempfile.NamedTemporaryFile('w', suffix='.asoundrc', delete=False) as f:
+    f.write(asoundrc)
+    conf = f.name
+
+env = dict(os.environ)
+env['ALSA_CONFIG_PATH'] = '/usr/share/alsa/alsa.conf:' + conf
+
+print('{} frames/s, {} channels, {} s per run'.format(rate, channels, seconds))
+print('{:>8} {:>8} {:>12} {:>12} {:>7}'.format('mode', 'readers', 'readers %cpu', 'system %cpu', 'failed'))
+
+try:
+    for n in readers:
+        for mode, pcm in (('dsnoop', 'bench_dsnoop'), ('shared', 'hw:{},{}'.format(card, shared_dev))):
+            proc, total, failed = run(pcm, n, env)
+            print('{:>8} {:>8} {:>12.2f} {:>12.2f} {:>7}'.format(mode, n, proc, total, failed))
+finally:
+    os.unlink(conf)
@@ -0,0 +1,64 @@
+"""
+Check the codec HPF ("HPF cutoff" control) and the CPU it saves,
+
+- DC and below-cutoff energy left in each channel of the capture
+- CPU time the same one pole HPF costs in software on this capture
+
+- requirements
+    sudo apt install python-numpy python-scipy
+"""
+
+
+import sys
+import time
+import wave
+import numpy as np
+from scipy import signal
+
+if len(sys.argv) < 2:
+    print('Usage: python {} audio.wav [cutoff-hz]'.format(sys.argv[0]))
+    sys.exit(1)
+
+cutoff = float(sys.argv[2]) if len(sys.argv) > 2 else 10.0
+
+wav = wave.open(sys.argv[1], 'rb')
+channels = wav.getnchannels()
+width = wav.getsampwidth()
+fs = wav.getframerate()
+nframes = wav.getnframes()
+frames = wav.readframes(nframes)
+wav.close()
+
+dtype = {2: 'int16', 4: 'int32'}[width]
+array = np.frombuffer(frames, dtype=dtype).reshape(-1, channels).astype(np.float64)
+array /= float(1 << (8 * width - 1))
+seconds = nframes / float(fs)
+
+print("channels: %d" % channels)
+print("rate    : %d" % fs)
+print("seconds : %.1f" % seconds)
+
+# the codec filter, y[n] = gain * (x[n] - x[n-1]) + coef * y[n-1]
+coef = np.exp(-2 * np.pi * cutoff / fs)
+gain = (1 + coef) / 2
+b = [gain, -gain]
+a = [1, -coef]
+
+low = signal.butter(2, cutoff / (fs / 2.0), 'low', output='sos')
+for c in range(channels):
+    x = array[:, c]
+    dc = np.mean(x)
+    below = np.sqrt(np.mean(signal.sosfilt(low, x - dc) ** 2))
+    print("CH%d DC %+.6f FS, < %gHz %.1f dBFS" % (c + 1, dc, cutoff, 20 * np.log10(below + 1e-12)))
+
+# software cost, per channel in blocks of 10ms like a capture loop
+block = fs // 100
+zi = np.zeros((channels, 1))
+t0 = time.process_time()
+for i in range(0, nframes - block + 1, block):
+    for c in range(channels):
+        y, zi[c] = signal.lfilter(b, a, array[i:i + block, c], zi=zi[c])
+t1 = time.process_time()
+
+print("software HPF: %.2f ms CPU per second of audio, %.3f%% of one core" %
+      ((t1 - t0) * 1000 / seconds, (t1 - t0) * 100 / seconds))
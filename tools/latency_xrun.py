@@ -0,0 +1,56 @@
+import subprocess
+import sys
+import time
+
+# xruns at each period size, duplex on the back-end of the voice card,
+# counted by the driver (/proc/asound/<card>/xruns).
+# With seeed-voice-card,low-latency only 1-2ms periods of whole FIFOs are accepted.
+#
+# Usage: python3 latency_xrun.py [card] [seconds] [channels]
+#   python3 latency_xrun.py seeed8micvoicec 60 8
+
+card = sys.argv[1] if len(sys.argv) > 1 else 'seeed8micvoicec'
+seconds = int(sys.argv[2]) if len(sys.argv) > 2 else 60
+channels = int(sys.argv[3]) if len(sys.argv) > 3 else 8
+
+rate = 48000
+periods = 4
+sizes = [48, 64, 72, 96, 128, 240, 480]
+
+
+def xruns():
+    # {period: (play_starts, play_xruns, capt_starts, capt_xruns)}
+    stat = {}
+    with open('/proc/asound/{}/xruns'.format(card)) as f:
+        for line in f.readlines()[1:]:
+            v = line.split()
+            if int(v[1]) == rate:
+                stat[int(v[0])] = tuple(int(x) for x in v[3:7])
+    return stat
+
+
+def run(size):
+    common = ['-q', '-D', 'hw:{},0'.format(card), '-t', 'raw', '-f', 'S32_LE',
+              '-r', str(rate), '-c', str(channels),
+              '--period-size={}'.format(size), '--buffer-size={}'.format(size * periods)]
+    capt = subprocess.Popen(['arecord'] + common + ['-d', str(seconds), '/dev/null'],
+                            stderr=subprocess.PIPE)
+    play = subprocess.Popen(['aplay'] + common + ['-d', str(seconds), '/dev/zero'],
+                            stderr=subprocess.PIPE)
+    err = (capt.communicate()[1] + play.communicate()[1]).decode()
+    return 'Invalid argument' not in err and 'Unable to install hw params' not in err
+
+
+print('{} Hz, {} channels, {} periods, {} s per size'.format(rate, channels, periods, seconds))
+print('{:>7} {:>9} {:>11} {:>11}'.format('period', 'period us', 'play xruns', 'capt xruns'))
+
+for size in sizes:
+    before = xruns().get(size, (0, 0, 0, 0))
+    ok = run(size)
+    time.sleep(0.5)
+    after = xruns().get(size, (0, 0, 0, 0))
+    us = size * 1000000 // rate
+    if not ok or after[2] == before[2]:
+        print('{:>7} {:>9} {:>23}'.format(size, us, 'rejected'))
+        continue
+    print('{:>7} {:>9} {:>11} {:>11}'.format(size, us, after[1] - before[1], after[3] - before[3]))